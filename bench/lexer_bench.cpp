@@ -0,0 +1,214 @@
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <qac/lexer/lexer.h>
+
+using namespace qac;
+using namespace std;
+
+DECLARE_int32(threads);
+
+DEFINE_int32(size_mb, 16, "Size of every generated deck in MB.");
+DEFINE_int32(iterations, 5, "Lexer runs per deck, the fastest one counts.");
+DEFINE_int32(seed, 42, "Seed of the deck generator.");
+DEFINE_string(mix, "plain,latex,table,list,image,all",
+              "Comma separated decks to lex. A deck is one feature or "
+              "several joined by '+', 'all' mixes every feature.");
+
+namespace {
+
+atomic<size_t> allocations(0);
+
+// Builds decks question by question from randomly picked words.
+class deck_generator {
+   public:
+    explicit deck_generator(unsigned seed) : random_(seed) {}
+
+    string word() {
+        static const vector<string> words = {
+            "the",   "a",       "question", "answer", "lexer", "token",
+            "is",    "of",      "and",      "which",  "deck",  "card",
+            "value", "compile", "memory",   "cache",  "line",  "file"};
+        return pick(words);
+    }
+
+    string words(int min, int max) {
+        string text = word();
+        for (int i = uniform_int_distribution<int>(min, max)(random_); i > 1;
+             --i) {
+            text += " " + word();
+        }
+        return text;
+    }
+
+    void plain(ostringstream &deck) {
+        deck << "Q: " << words(4, 12) << "?\n"
+             << "A: " << words(3, 8) << " *" << words(1, 3) << "* "
+             << words(2, 6) << " _" << word() << "_ `" << word() << "`.\n\n";
+    }
+
+    void latex(ostringstream &deck) {
+        static const vector<string> commands = {
+            "\\frac{a}{b}", "\\sum_{i=0}^{n}", "x^2", "\\alpha", "+", "=",
+            "\\int_0^1",    "\\sqrt{2}",       "y_i", "\\cdot"};
+
+        deck << "Q: " << words(2, 5) << " \\(" << pick(commands) << " "
+             << pick(commands) << "\\)?\n"
+             << "A: \\[\n";
+        for (int i = uniform_int_distribution<int>(1, 4)(random_); i > 0;
+             --i) {
+            deck << "   " << pick(commands) << " " << pick(commands) << " "
+                 << pick(commands) << "\n";
+        }
+        deck << "   \\]\n\n";
+    }
+
+    void table(ostringstream &deck) {
+        deck << "Q: " << words(3, 6) << "?\n"
+             << "A: |< " << word() << " |- " << word() << " |> " << word()
+             << " |\n"
+             << "   ---\n";
+        for (int i = uniform_int_distribution<int>(2, 6)(random_); i > 0;
+             --i) {
+            deck << "   | " << words(1, 3) << " | " << word() << " | "
+                 << word() << " |\n";
+        }
+        deck << "\n";
+    }
+
+    void list(ostringstream &deck) {
+        deck << "Q: " << words(3, 6) << "?\n"
+             << "A: - " << words(2, 5) << "\n";
+        for (int i = uniform_int_distribution<int>(2, 6)(random_); i > 0;
+             --i) {
+            deck << "   " << (i % 2 ? "- " : "#. ") << words(2, 5) << "\n";
+        }
+        deck << "\n";
+    }
+
+    void image(ostringstream &deck) {
+        deck << "Q: " << words(3, 6) << "?\n"
+             << "A: IMG(img/" << word() << ".png,"
+             << uniform_int_distribution<int>(50, 500)(random_) << ") "
+             << words(1, 4) << "\n\n";
+    }
+
+    string generate(const vector<string> &features, size_t size) {
+        static const map<string, void (deck_generator::*)(ostringstream &)>
+            generators = {{"plain", &deck_generator::plain},
+                          {"latex", &deck_generator::latex},
+                          {"table", &deck_generator::table},
+                          {"list", &deck_generator::list},
+                          {"image", &deck_generator::image}};
+
+        ostringstream deck;
+        for (int chapter = 1; static_cast<size_t>(deck.tellp()) < size;
+             ++chapter) {
+            deck << "CHA: Chapter " << chapter << "\n\n";
+            for (int i = 0; i < 100 && static_cast<size_t>(deck.tellp()) < size;
+                 ++i) {
+                (this->*generators.at(pick(features)))(deck);
+            }
+        }
+
+        return deck.str();
+    }
+
+   private:
+    const string &pick(const vector<string> &strings) {
+        return strings[uniform_int_distribution<size_t>(
+            0, strings.size() - 1)(random_)];
+    }
+
+    mt19937 random_;
+};
+
+vector<string> split(const string &text, char delimiter) {
+    vector<string> parts;
+    istringstream input(text);
+    for (string part; getline(input, part, delimiter);) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+void run(const string &name, const string &deck) {
+    double best_seconds = 0;
+    size_t tokens = 0;
+    size_t allocs = 0;
+
+    for (int i = 0; i < max(FLAGS_iterations, 1); ++i) {
+        lexer lexer;
+        lexer.set_threads(max(FLAGS_threads, 0));
+
+        size_t allocs_before = allocations.load();
+        auto start = chrono::steady_clock::now();
+        tokens = lexer.lex(deck.data(), deck.size()).size();
+        chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+        allocs = allocations.load() - allocs_before;
+
+        if (i == 0 || seconds.count() < best_seconds) {
+            best_seconds = seconds.count();
+        }
+    }
+
+    double mb = deck.size() / (1024.0 * 1024.0);
+    printf("%-28s %8.1f %10zu %10.1f %12.0f %8zu %10.4f\n", name.c_str(),
+           mb, tokens, mb / best_seconds, tokens / best_seconds, allocs,
+           tokens ? double(allocs) / tokens : 0.0);
+}
+}
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+int main(int argc, char *argv[]) {
+    gflags::SetUsageMessage("[flags]");
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    const vector<string> all_features = {"plain", "latex", "table", "list",
+                                         "image"};
+    size_t size = static_cast<size_t>(max(FLAGS_size_mb, 1)) << 20;
+
+    printf("%-28s %8s %10s %10s %12s %8s %10s\n", "deck", "MB", "tokens",
+           "MB/s", "tokens/s", "allocs", "allocs/tok");
+
+    for (const string &name : split(FLAGS_mix, ',')) {
+        vector<string> features =
+            name == "all" ? all_features : split(name, '+');
+
+        deck_generator generator(FLAGS_seed);
+        string deck;
+        try {
+            deck = generator.generate(features, size);
+        } catch (out_of_range &) {
+            fprintf(stderr, "Unknown deck feature in '%s'\n", name.c_str());
+            return 1;
+        }
+
+        run(name, deck);
+    }
+
+    return 0;
+}
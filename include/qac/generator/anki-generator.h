@@ -17,37 +17,41 @@ class anki_generator : public html_generator {
     virtual void render_underlined(std::ostream &os,
                                    const std::string &text) override;
 
-    virtual void render_chapter(std::ostream &os, const std::string &caption,
-                                const std::string &questions,
-                                const std::string &sections,
-                                const ast_chapter *chapter) override;
-
-    virtual void render_section(std::ostream &os, const std::string &caption,
-                                const std::string &questions,
-                                const std::string &subsections,
-                                const ast_section *section) override;
-
-    virtual void render_subsection(std::ostream &os, const std::string &caption,
-                                   const std::string &questions,
-                                   const ast_subsection *subsection) override;
+    // only the questions are written, as lines of a text file
+    virtual void render_document_begin(std::ostream &os) override;
+    virtual void render_document_end(std::ostream &os) override;
+
+    virtual void render_chapter_begin(std::ostream &os,
+                                      const ast_chapter *chapter) override;
+    virtual void render_chapter_sections(std::ostream &os,
+                                         const ast_chapter *chapter) override;
+    virtual void render_chapter_end(std::ostream &os,
+                                    const ast_chapter *chapter) override;
+
+    virtual void render_section_begin(std::ostream &os,
+                                      const ast_section *section) override;
+    virtual void render_section_subsections(
+        std::ostream &os, const ast_section *section) override;
+    virtual void render_section_end(std::ostream &os,
+                                    const ast_section *section) override;
+
+    virtual void render_subsection_begin(
+        std::ostream &os, const ast_subsection *subsection) override;
+    virtual void render_subsection_end(
+        std::ostream &os, const ast_subsection *subsection) override;
 
     virtual void render_question(std::ostream &os, const std::string &question,
                                  const std::string &answer,
                                  const ast_question *pquestion) override;
 
-    virtual void render_document(std::ostream &os,
-                                 const std::string &body) override;
-
-    virtual void render_table_cell(std::ostream &os,
-                                   const std::string &cell_body) override;
-    virtual void render_table_cell_left_aligned(
-        std::ostream &os, const std::string &cell_body) override;
-    virtual void render_table_cell_right_aligned(
-        std::ostream &os, const std::string &cell_body) override;
-    virtual void render_table_cell_center_aligned(
-        std::ostream &os, const std::string &cell_body) override;
-    virtual void render_table(std::ostream &os,
-                              const std::string &rows) override;
+    virtual void render_table_cell_begin(std::ostream &os) override;
+    virtual void render_table_cell_left_aligned_begin(
+        std::ostream &os) override;
+    virtual void render_table_cell_right_aligned_begin(
+        std::ostream &os) override;
+    virtual void render_table_cell_center_aligned_begin(
+        std::ostream &os) override;
+    virtual void render_table_begin(std::ostream &os) override;
 
     virtual void render_normal_latex(std::ostream &os, const std::string &text) override;
     virtual void render_centered_latex(std::ostream &os, const std::string &text) override;
@@ -21,7 +21,20 @@ class generator {
     virtual std::string get_name() = 0;
     virtual std::string get_description() = 0;
 
-    void generate(qac::cst_node *root, std::ostream &os);
+    void generate(const qac::cst &tree, std::ostream &os);
+    // parses and renders the deck without building the cst
+    void generate(parser &parser, token_source &tokens, std::ostream &os);
+    // Renders an AST built by an ast_builder. The tree isn't changed, other
+    // generators may render it at the same time.
+    void render(const ast_node &root, std::ostream &os);
+
+    // The questions are rendered on this many threads, 0 uses all hardware
+    // threads. The render calls of a question may then run at the same time
+    // as others. The output is the same as with a single thread.
+    void set_threads(unsigned threads) { threads_ = threads; }
+
+    // Appends the question text or the answer in this generator's format.
+    virtual void render_text(std::string &out, const ast_text &text);
 
     virtual void render_image(std::ostream &os, const std::string &source,
                               int width, int height) = 0;
@@ -29,52 +42,70 @@ class generator {
     virtual void render_underlined(std::ostream &os,
                                    const std::string &text) = 0;
     virtual void render_code(std::ostream &os, const std::string &text) = 0;
-    virtual void render_unordered_list(std::ostream &os,
-                                       const std::string &text) = 0;
-    virtual void render_unordered_list_item(std::ostream &os,
-                                            const std::string &text) = 0;
-    virtual void render_ordered_list(std::ostream &os,
-                                     const std::string &text) = 0;
-    virtual void render_ordered_list_item(std::ostream &os,
-                                          const std::string &text) = 0;
+
+    // A list or a table is rendered around its content, which is written
+    // between the begin and the end call.
+    virtual void render_unordered_list_begin(std::ostream &os) = 0;
+    virtual void render_unordered_list_end(std::ostream &os) = 0;
+    virtual void render_unordered_list_item_begin(std::ostream &os) = 0;
+    virtual void render_unordered_list_item_end(std::ostream &os) = 0;
+    virtual void render_ordered_list_begin(std::ostream &os) = 0;
+    virtual void render_ordered_list_end(std::ostream &os) = 0;
+    virtual void render_ordered_list_item_begin(std::ostream &os) = 0;
+    virtual void render_ordered_list_item_end(std::ostream &os) = 0;
 
     virtual void render_normal_latex(std::ostream &os, const std::string &text);
     virtual void render_centered_latex(std::ostream &os,
                                        const std::string &text);
 
-    virtual void render_chapter(std::ostream &os, const std::string &caption,
-                                const std::string &questions,
-                                const std::string &sections,
-                                const ast_chapter *chapter) = 0;
-
-    virtual void render_section(std::ostream &os, const std::string &caption,
-                                const std::string &questions,
-                                const std::string &subsections,
-                                const ast_section *section) = 0;
-
-    virtual void render_subsection(std::ostream &os, const std::string &caption,
-                                   const std::string &questions,
-                                   const ast_subsection *subsection) = 0;
+    // The document is written to the output as it is rendered. A chapter
+    // is its begin call, its questions, the sections call, its sections and
+    // its end call, likewise a section. Chapters, sections and subsections
+    // without questions are left out.
+    virtual void render_document_begin(std::ostream &os) = 0;
+    virtual void render_document_end(std::ostream &os) = 0;
+
+    virtual void render_chapter_begin(std::ostream &os,
+                                      const ast_chapter *chapter) = 0;
+    virtual void render_chapter_sections(std::ostream &os,
+                                         const ast_chapter *chapter);
+    virtual void render_chapter_end(std::ostream &os,
+                                    const ast_chapter *chapter) = 0;
+
+    virtual void render_section_begin(std::ostream &os,
+                                      const ast_section *section) = 0;
+    virtual void render_section_subsections(std::ostream &os,
+                                            const ast_section *section);
+    virtual void render_section_end(std::ostream &os,
+                                    const ast_section *section) = 0;
+
+    virtual void render_subsection_begin(std::ostream &os,
+                                         const ast_subsection *subsection) = 0;
+    virtual void render_subsection_end(std::ostream &os,
+                                       const ast_subsection *subsection) = 0;
 
     virtual void render_question(std::ostream &os, const std::string &question,
                                  const std::string &answer,
                                  const ast_question *pquestion) = 0;
 
-    virtual void render_document(std::ostream &os, const std::string &body) = 0;
-
-    virtual void render_table_cell(std::ostream &os,
-                                   const std::string &cell_body) = 0;
-    virtual void render_table_cell_left_aligned(
-        std::ostream &os, const std::string &cell_body) = 0;
-    virtual void render_table_cell_right_aligned(
-        std::ostream &os, const std::string &cell_body) = 0;
-    virtual void render_table_cell_center_aligned(
-        std::ostream &os, const std::string &cell_body) = 0;
-    virtual void render_table_row(std::ostream &os,
-                                  const std::string &cells) = 0;
-    virtual void render_table(std::ostream &os, const std::string &rows) = 0;
+    virtual void render_table_cell_begin(std::ostream &os) = 0;
+    virtual void render_table_cell_left_aligned_begin(std::ostream &os) = 0;
+    virtual void render_table_cell_right_aligned_begin(std::ostream &os) = 0;
+    virtual void render_table_cell_center_aligned_begin(std::ostream &os) = 0;
+    virtual void render_table_cell_end(std::ostream &os) = 0;
+    virtual void render_table_row_begin(std::ostream &os) = 0;
+    virtual void render_table_row_end(std::ostream &os) = 0;
+    virtual void render_table_begin(std::ostream &os) = 0;
+    virtual void render_table_end(std::ostream &os) = 0;
 
    private:
+    void render_begin(std::ostream &os, const ast_text::element &element,
+                      ast_text_enum parent);
+    void render_end(std::ostream &os, ast_text_enum type,
+                    ast_text_enum parent);
+
+    unsigned threads_ = 1;
+
     int chapter_counter_ = 0;
     int section_counter_ = 0;
     int subsection_counter_ = 0;
@@ -0,0 +1,55 @@
+#ifndef QAC_DELIMITER_SCANNER_H
+#define QAC_DELIMITER_SCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace qac {
+
+// Structural bytes of a 64 byte block, bit i stands for byte i of the block.
+struct block_masks {
+    uint64_t newline = 0;
+    uint64_t space = 0;
+    uint64_t markup = 0;  // one of * _ ` \ | #
+};
+
+using scan_block_fn = void (*)(const char *block, block_masks &masks);
+
+// Finds newlines, spaces and markup bytes of a buffer block by block. The
+// blocks are classified with SSE2 or AVX2 if the CPU supports it (chosen at
+// runtime), otherwise with a portable scalar loop.
+class delimiter_scanner {
+   public:
+    static constexpr std::size_t BLOCK_SIZE = 64;
+
+    delimiter_scanner(const char *data, std::size_t size);
+
+    // first newline/space in [from, to), or to if there is none
+    const char *find_newline(const char *from, const char *to) {
+        return find(from, to, &block_masks::newline);
+    }
+    const char *find_space(const char *from, const char *to) {
+        return find(from, to, &block_masks::space);
+    }
+
+    bool is_markup(const char *pos);
+
+    static const char *implementation_name();
+
+    static scan_block_fn scalar_implementation();
+    static scan_block_fn best_implementation();
+
+   private:
+    const char *find(const char *from, const char *to,
+                     uint64_t block_masks::*mask);
+    void load_block(std::size_t block);
+
+    const char *data_;
+    std::size_t size_;
+    std::size_t block_ = SIZE_MAX;
+    block_masks masks_;
+    scan_block_fn scan_block_;
+};
+}
+
+#endif  // QAC_DELIMITER_SCANNER_H
@@ -1,13 +1,24 @@
 #ifndef QAC_LEXER_H
 #define QAC_LEXER_H
 
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace qac {
 
-enum class token_enum {
+class delimiter_scanner;
+class mapped_file;
+class thread_pool;
+class token_cache;
+
+enum class token_enum : uint8_t {
     END_OF_FILE = 0,
     QUESTION,
     ANSWER,
@@ -41,77 +52,125 @@ enum class token_enum {
 std::string to_string(token_enum tenum);
 std::ostream& operator<<(std::ostream& os, token_enum tenum);
 
-class lexer_state {
-   public:
-    bool matches_opening_token(std::string& word);
-    std::pair<bool, std::string> matches_closing_token(std::string& word);
-
-    virtual token_enum get_opening_token() = 0;
-    virtual token_enum get_in_between_token() = 0;
-    virtual token_enum get_closing_token() = 0;
-    virtual std::string get_opening_string_token() = 0;
-    virtual std::string get_closing_string_token() = 0;
-
-   private:
-    bool ends_with_punctuation(const std::string& word);
+// A delimited part of a line, e.g. "\( ... \)" or "*...*". The words in
+// between are lexed as in_between_token until the closing delimiter is found.
+struct lexer_state {
+    std::string_view opening;
+    std::string_view closing;
+    token_enum opening_token;
+    token_enum in_between_token;
+    token_enum closing_token;
 };
 
+// A token does not own its text, it only spans a part of the lexed source
+// buffer. The buffer has to outlive the token.
 class token {
     friend std::ostream& operator<<(std::ostream& os, const token& token);
 
    public:
-    token(token_enum token, const std::string& value, uint16_t line)
-        : token_(token), value_(value), line_(line) {}
+    token(token_enum token, std::string_view value, uint32_t line,
+          uint32_t column = 0, uint16_t file = 0)
+        : value_(value.data()),
+          length_(static_cast<uint32_t>(value.size())),
+          line_(line),
+          column_(column),
+          file_(file),
+          token_(token) {}
     bool is(token_enum token) const;
     token_enum get_token() const;
-    std::string get_value() const;
-
-    uint16_t line() const {
-        return line_;
+    std::string_view get_value() const {
+        return std::string_view(value_, length_);
     }
 
+    uint32_t line() const { return line_; }
+
+    uint32_t column() const { return column_; }
+
+    // index into the lexer's files(), 0 is the lexed input itself
+    uint16_t file() const { return file_; }
+
     inline bool operator==(const token& rhs) const {
-        return token_ == rhs.token_ && value_ == rhs.value_ &&
+        return token_ == rhs.token_ && get_value() == rhs.get_value() &&
                line_ == rhs.line_;
     }
 
    private:
+    const char* value_;
+    uint32_t length_;
+    uint32_t line_;
+    uint32_t column_;
+    uint16_t file_;
     token_enum token_;
-    std::string value_;
-    uint16_t line_;
 };
 
 std::ostream& operator<<(std::ostream& os, const token& token);
 
+// The returned tokens point into the lexed text. A buffer passed to lex()
+// has to outlive them, streams and included files are kept alive by the
+// lexer itself.
 class lexer {
+    friend class token_stream;
+
    public:
     lexer();
+    ~lexer();
     std::vector<token> lex(std::istream& input);
-    
-    static bool include_file(std::string filename) {
-        auto ret = included_files_.insert(filename);
-        return ret.second;
-    }
+    std::vector<token> lex(const char* data, std::size_t size);
+
+    // Lexes a file together with the files it includes. Included files are
+    // lexed concurrently and every file is only included once, at its first
+    // FILE: line.
+    std::vector<token> lex_file(const std::string& filename);
+
+    // Large inputs are split into chunks which are lexed on this many
+    // threads, 0 uses all hardware threads. The tokens are the same as with
+    // a single thread.
+    void set_threads(unsigned threads) { threads_ = threads; }
+
+    // Files found in the cache are not lexed, the lexed ones are stored. The
+    // cache has to outlive the lexer.
+    void set_cache(const token_cache* cache) { cache_ = cache; }
+
+    // names of the lexed files as given, indexed by token::file()
+    const std::vector<std::string>& files() const { return files_; }
+
+    // whether the lexed text ended within a delimiter, e.g. after "\[", so
+    // the lines following it would be lexed differently
+    bool in_delimiter() const { return cur_lexer_state_ != nullptr; }
 
    private:
-    const std::string TOKEN_COMMENT = "#";
-    const std::string TOKEN_CHAPTER = "CHA:";
-    const std::string TOKEN_SECTION = "SEC:";
-    const std::string TOKEN_SUBSECTION = "SUB:";
-    const std::string TOKEN_QUESTION = "Q:";
-    const std::string TOKEN_ANSWER = "A:";
-    const std::string TOKEN_FILE = "FILE:";
-    const std::string TOKEN_UNORDERED_LIST_ITEM = "-";
-    const std::string TOKEN_ORDERED_LIST_ITEM = "#.";
-    const std::string TOKEN_TABLE_CELL = "|";
-    const std::string TOKEN_TABLE_CELL_LEFT_ALIGNED = "|<";
-    const std::string TOKEN_TABLE_CELL_RIGHT_ALIGNED = "|>";
-    const std::string TOKEN_TABLE_CELL_CENTER_ALIGNED = "|-";
-
-    void lex_line(std::vector<token>& tokens, const std::string& line,
-                  int line_nr);
-
-    void lex_file(const std::string &line, uint16_t line_nr);
+    // a FILE: line, its tokens go in front of tokens_[position]
+    struct pending_include {
+        std::size_t position;
+        std::string filename;
+        std::string path;
+    };
+
+    // tokens to splice, file is 0 if they already have their file id
+    struct token_range {
+        const token* first;
+        const token* last;
+        uint16_t file;
+    };
+
+    void lex_text(const char* data, std::size_t size);
+    bool load_cached(const std::string& key, const char* data,
+                     std::size_t size);
+    std::string cache_entry(const char* data, std::size_t first) const;
+    void lex_lines(const char* data, std::size_t size);
+    void lex_chunks(const char* data, std::size_t size);
+    void append_chunk(const lexer& chunk, uint32_t line_offset);
+    void lex_line(std::vector<token>& tokens, std::string_view line,
+                  uint32_t line_nr, delimiter_scanner& scanner);
+    void push_token(std::vector<token>& tokens, token_enum tenum,
+                    std::string_view value, std::string_view line,
+                    uint32_t line_nr);
+
+    void queue_includes(const std::vector<pending_include>& includes);
+    void splice_includes();
+    void collect_ranges(const lexer& file, uint16_t file_id,
+                        std::vector<token_range>& ranges,
+                        std::vector<std::unique_ptr<lexer>>& included);
 
     bool next_char_equals(const std::string& line, const size_t& cur_pos,
                           const char& letter) const;
@@ -120,11 +179,24 @@ class lexer {
     bool has_nth_char(const size_t& pos, const std::string& line) const;
 
     bool in_latex_ = false;
-    lexer_state* cur_lexer_state_ = nullptr;
-    std::vector<std::unique_ptr<qac::lexer_state>> possible_states_;
+    unsigned threads_ = 1;
+    const token_cache* cache_ = nullptr;
+    const lexer_state* cur_lexer_state_ = nullptr;
+    uint32_t line_count_ = 0;
+    uint16_t file_id_ = 0;
+    std::vector<std::string> files_;
+    std::vector<pending_include> pending_includes_;
     std::vector<token> tokens_;
-    
-    static std::set<std::string> included_files_;
+    std::vector<std::unique_ptr<std::string>> buffers_;
+    std::vector<std::unique_ptr<mapped_file>> mapped_files_;
+
+    // canonical paths of the files spliced into tokens_
+    std::set<std::string> included_files_;
+    // lexers of all files queued so far, shared with the include pool
+    std::mutex includes_mutex_;
+    std::map<std::string, std::future<std::unique_ptr<lexer>>>
+        include_lexers_;
+    thread_pool* include_pool_ = nullptr;
 };
 }
 
@@ -0,0 +1,36 @@
+#ifndef QAC_MAPPED_FILE_H
+#define QAC_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace qac {
+
+// Read-only view of a whole file. On POSIX systems the file is memory-mapped,
+// so the lexer can walk it in place without copying it line by line.
+class mapped_file {
+   public:
+    explicit mapped_file(const std::string &filename);
+    ~mapped_file();
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    const char *data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::string_view text() const { return std::string_view(data_, size_); }
+
+   private:
+    const char *data_ = "";
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+    std::string buffer_;
+};
+
+// Absolute path of filename without symlinks, . and .., so different
+// spellings of a path compare equal. filename itself if it can't be resolved.
+std::string canonical_path(const std::string &filename);
+}
+
+#endif  // QAC_MAPPED_FILE_H
@@ -0,0 +1,80 @@
+#ifndef QAC_SYMBOL_TABLE_H
+#define QAC_SYMBOL_TABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <qac/lexer/lexer.h>
+#include <qac/lexer/token_source.h>
+
+namespace qac {
+
+// Stores every distinct token value once. Ids are dense, starting at 0.
+class symbol_table {
+   public:
+    uint32_t intern(std::string_view text);
+    std::string_view text(uint32_t symbol) const { return symbols_[symbol]; }
+
+    std::size_t size() const { return symbols_.size(); }
+    // bytes of the text, the id index and the hash table
+    std::size_t memory_usage() const;
+
+   private:
+    std::string_view store(std::string_view text);
+
+    std::unordered_map<std::string_view, uint32_t> ids_;
+    std::vector<std::string_view> symbols_;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    std::size_t block_used_ = 0;
+    std::size_t block_size_ = 0;
+    std::size_t text_bytes_ = 0;
+};
+
+// A token whose value is a symbol_table id.
+struct compact_token {
+    uint32_t symbol;
+    uint32_t line;
+    uint16_t file;
+    token_enum token;
+};
+
+static_assert(sizeof(compact_token) == 12, "compact_token is not packed");
+
+// Tokens with interned values. The resolved tokens point into the symbol
+// table, so the lexed source doesn't have to be kept.
+class interned_tokens {
+   public:
+    explicit interned_tokens(const std::vector<token>& tokens);
+
+    std::size_t size() const { return tokens_.size(); }
+    token operator[](std::size_t i) const {
+        const compact_token& t = tokens_[i];
+        return token(t.token, symbols_.text(t.symbol), t.line, 0, t.file);
+    }
+
+    const symbol_table& symbols() const { return symbols_; }
+    std::size_t memory_usage() const;
+
+   private:
+    symbol_table symbols_;
+    std::vector<compact_token> tokens_;
+};
+
+class interned_token_source : public token_source {
+   public:
+    explicit interned_token_source(const interned_tokens& tokens)
+        : tokens_(tokens) {}
+
+    const token& peek() override;
+    token next() override;
+
+   private:
+    const interned_tokens& tokens_;
+    std::size_t next_ = 0;
+    token peeked_ = token(token_enum::END_OF_FILE, "", 0);
+};
+}
+
+#endif  // QAC_SYMBOL_TABLE_H
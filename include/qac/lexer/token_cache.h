@@ -0,0 +1,37 @@
+#ifndef QAC_TOKEN_CACHE_H
+#define QAC_TOKEN_CACHE_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace qac {
+
+class mapped_file;
+
+// Lexed files on disk, keyed by a 128 bit hash of the qac version and the
+// file's contents. An unchanged file is then read from one mapped entry
+// instead of being lexed. The lexer writes the entries, this only stores
+// them.
+class token_cache {
+   public:
+    // creates the directory if it doesn't exist
+    explicit token_cache(const std::string &directory);
+
+    // the hash in hex, with the size of the text
+    std::string key(std::string_view text) const;
+
+    // the entry mapped into memory, nullptr if there is none
+    std::unique_ptr<mapped_file> read(const std::string &key) const;
+
+    // Entries are written to a temporary file and renamed, so concurrent
+    // runs never see half an entry. A failed write is ignored, the file is
+    // lexed again next time.
+    void write(const std::string &key, std::string_view entry) const;
+
+   private:
+    std::string directory_;
+};
+}
+
+#endif  // QAC_TOKEN_CACHE_H
@@ -0,0 +1,43 @@
+#ifndef QAC_TOKEN_SOURCE_H
+#define QAC_TOKEN_SOURCE_H
+
+#include <vector>
+#include <qac/lexer/lexer.h>
+
+namespace qac {
+
+// Tokens as the parser consumes them, looking at most one token ahead. After
+// the last token an END_OF_FILE token is returned.
+class token_source {
+   public:
+    virtual ~token_source() {}
+
+    virtual const token& peek() = 0;
+    virtual token next() = 0;
+};
+
+// Tokens which were lexed in advance.
+class token_vector_source : public token_source {
+   public:
+    explicit token_vector_source(const std::vector<token>& tokens)
+        : current_(tokens.cbegin()), end_(tokens.cend()) {}
+    token_vector_source(std::vector<token>::const_iterator begin,
+                        std::vector<token>::const_iterator end)
+        : current_(begin), end_(end) {}
+
+    const token& peek() override {
+        return current_ != end_ ? *current_ : end_of_file_;
+    }
+
+    token next() override {
+        return current_ != end_ ? *current_++ : end_of_file_;
+    }
+
+   private:
+    std::vector<token>::const_iterator current_;
+    std::vector<token>::const_iterator end_;
+    token end_of_file_ = token(token_enum::END_OF_FILE, "", 0);
+};
+}
+
+#endif  // QAC_TOKEN_SOURCE_H
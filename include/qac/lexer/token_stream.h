@@ -0,0 +1,67 @@
+#ifndef QAC_TOKEN_STREAM_H
+#define QAC_TOKEN_STREAM_H
+
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <qac/lexer/lexer.h>
+#include <qac/lexer/token_source.h>
+
+namespace qac {
+
+class delimiter_scanner;
+class mapped_file;
+
+// Lexes its input line by line while the tokens are consumed, so only the
+// tokens of the current line are held in memory. Included files are streamed
+// by a nested token_stream when their FILE: line is reached.
+class token_stream : public token_source {
+   public:
+    explicit token_stream(const std::string& filename);
+    explicit token_stream(std::istream& input);
+    ~token_stream();
+
+    const token& peek() override;
+    token next() override;
+
+    // names of the files streamed so far, indexed by token::file()
+    const std::vector<std::string>& files() const { return files_; }
+
+   private:
+    token_stream(const std::string& filename,
+                 std::set<std::string>& included_files,
+                 std::vector<std::string>& files);
+
+    bool lex_next_line();
+    bool read_line(std::string_view& line);
+
+    std::unique_ptr<mapped_file> file_;
+    std::unique_ptr<delimiter_scanner> scanner_;
+    const char* pos_ = nullptr;
+    const char* end_ = nullptr;
+
+    // lines read from a stream, the last one holds the last returned token
+    std::istream* input_ = nullptr;
+    std::deque<std::string> lines_;
+
+    lexer lexer_;
+    uint32_t line_nr_ = 0;
+    std::vector<token> line_tokens_;
+    std::size_t next_ = 0;
+
+    std::set<std::string> own_included_files_;
+    std::set<std::string>& included_files_;
+    std::vector<std::string> own_files_;
+    std::vector<std::string>& files_;
+    std::unique_ptr<token_stream> include_;
+    // keeps the last token of a finished include valid
+    std::unique_ptr<token_stream> finished_include_;
+
+    token end_of_file_ = token(token_enum::END_OF_FILE, "", 0);
+};
+}
+
+#endif  // QAC_TOKEN_STREAM_H
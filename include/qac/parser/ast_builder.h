@@ -0,0 +1,78 @@
+#ifndef QAC_AST_BUILDER_H
+#define QAC_AST_BUILDER_H
+
+#include <qac/parser/ast_nodes.h>
+#include <qac/parser/parse_handler.h>
+
+#include <memory>
+
+namespace qac {
+
+enum class ast_builder_state { IN_ROOT, IN_CHAPTER, IN_SECTION, IN_SUBSECTION };
+
+// Builds the AST from parse events. It doesn't depend on a generator, the
+// texts of the questions are kept as ast_texts.
+class ast_builder : public parse_handler {
+   public:
+    ast_node::ptr root() { return std::move(root_); }
+
+    virtual void on_document_end() override;
+
+    virtual void on_chapter_begin(std::string_view caption) override;
+    virtual void on_chapter_end() override;
+    virtual void on_section_begin(std::string_view caption) override;
+    virtual void on_section_end() override;
+    virtual void on_subsection_begin(std::string_view caption) override;
+    virtual void on_subsection_end() override;
+
+    virtual void on_question_end() override;
+    virtual void on_question_text_begin() override;
+    virtual void on_question_text_end() override;
+    virtual void on_answer_text_begin() override;
+    virtual void on_answer_text_end() override;
+
+    virtual void on_text(std::string_view words) override;
+    virtual void on_image(std::string_view source, int width,
+                          int height) override;
+    virtual void on_latex(std::string_view body, bool centered) override;
+    virtual void on_bold(std::string_view words) override;
+    virtual void on_underlined(std::string_view words) override;
+    virtual void on_code(std::string_view words) override;
+
+    virtual void on_unordered_list_begin() override;
+    virtual void on_unordered_list_end() override;
+    virtual void on_ordered_list_begin() override;
+    virtual void on_ordered_list_end() override;
+    virtual void on_list_item_begin() override;
+    virtual void on_list_item_end() override;
+
+    virtual void on_table_begin() override;
+    virtual void on_table_end() override;
+    virtual void on_table_row_begin() override;
+    virtual void on_table_row_end() override;
+    virtual void on_table_cell_begin(cst_alignment_enum alignment) override;
+    virtual void on_table_cell_end() override;
+
+   private:
+    ast_builder_state state_ = ast_builder_state::IN_ROOT;
+
+    ast_node::ptr root_;
+
+    // the question text or the answer being built
+    ast_text text_;
+    ast_text question_text_;
+    ast_text answer_text_;
+
+    ast_chapter::ptr chapter_;
+    ast_section::ptr section_;
+    ast_subsection::ptr subsection_;
+
+    uint16_t nth_chapter_ = 0;
+    uint16_t nth_section_ = 0;
+    uint16_t nth_subsection_ = 0;
+    uint32_t nth_question_ = 0;
+};
+
+}  // namespace qac
+
+#endif  // QAC_AST_BUILDER_H
@@ -1,8 +1,12 @@
 #ifndef QAC_AST_NODES_H
 #define QAC_AST_NODES_H
 
+#include <qac/parser/cst_nodes.h>
+
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace qac {
@@ -27,14 +31,68 @@ class ast_root_questions;
 class ast_section;
 class ast_subsection;
 
+// The visitors only read the tree, so one tree can be rendered by several
+// generators at the same time.
 class ast_visitor {
    public:
-    virtual void visit(ast_chapter *node) = 0;
-    virtual void visit(ast_question *node) = 0;
-    virtual void visit(ast_root_chapters *node) = 0;
-    virtual void visit(ast_root_questions *node) = 0;
-    virtual void visit(ast_section *node) = 0;
-    virtual void visit(ast_subsection *node) = 0;
+    virtual void visit(const ast_chapter *node) = 0;
+    virtual void visit(const ast_question *node) = 0;
+    virtual void visit(const ast_root_chapters *node) = 0;
+    virtual void visit(const ast_root_questions *node) = 0;
+    virtual void visit(const ast_section *node) = 0;
+    virtual void visit(const ast_subsection *node) = 0;
+};
+
+enum class ast_text_enum : uint8_t {
+    TEXT,
+    IMAGE,
+    LATEX,
+    CENTERED_LATEX,
+    BOLD,
+    UNDERLINED,
+    CODE,
+    UNORDERED_LIST,
+    ORDERED_LIST,
+    LIST_ITEM,
+    TABLE,
+    TABLE_ROW,
+    TABLE_CELL,
+    END
+};
+
+// A question text or an answer, independent of the output format. Every
+// generator renders it itself.
+//
+// The elements are kept in document order. A list, a list item, a table, a
+// row and a cell are followed by their content and an END element. The
+// words of all elements are stored in one string.
+class ast_text {
+   public:
+    struct element {
+        ast_text_enum type;
+        cst_alignment_enum alignment = cst_alignment_enum::STANDARD;
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        int width = -1;
+        int height = -1;
+    };
+
+    // Adds a text, a LaTeX formula, a bold, underlined or code span, or the
+    // start of a list, an item, a table or a row.
+    void add(ast_text_enum type, std::string_view words = {});
+    void add_image(std::string_view source, int width, int height);
+    void add_table_cell(cst_alignment_enum alignment);
+    void end() { elements_.push_back(element{ast_text_enum::END}); }
+
+    const std::vector<element> &elements() const { return elements_; }
+    // the words, the image source or the LaTeX body of the element
+    std::string_view words(const element &element) const {
+        return std::string_view(words_).substr(element.offset, element.length);
+    }
+
+   private:
+    std::vector<element> elements_;
+    std::string words_;
 };
 
 class ast_node {
@@ -45,7 +103,7 @@ class ast_node {
 
     ast_node_enum type() const { return type_; }
 
-    virtual void accept(ast_visitor &visitor) = 0;
+    virtual void accept(ast_visitor &visitor) const = 0;
 
    private:
     ast_node_enum type_;
@@ -55,18 +113,17 @@ class ast_question : public ast_node {
    public:
     using ptr = std::unique_ptr<ast_question>;
 
-    ast_question(uint16_t nth, const std::string &question,
-                 const std::string &answer)
+    ast_question(uint32_t nth, ast_text question, ast_text answer)
         : ast_node(ast_node_enum::QUESTION),
-          nth_question_(nth),
-          question_(question),
-          answer_(answer) {}
+          question_(std::move(question)),
+          answer_(std::move(answer)),
+          nth_question_(nth) {}
 
-    uint16_t nth_question() const { return nth_question_; }
+    uint32_t nth_question() const { return nth_question_; }
 
-    const std::string &question() const { return question_; }
+    const ast_text &question() const { return question_; }
 
-    const std::string &answer() const { return answer_; }
+    const ast_text &answer() const { return answer_; }
 
     void chapter(ast_chapter *chapter) { chapter_ = chapter; }
     void section(ast_section *section) { section_ = section; }
@@ -82,13 +139,15 @@ class ast_question : public ast_node {
     const std::string &section() const;
     const std::string &subsection() const;
 
-    virtual void accept(ast_visitor &visitor) override { visitor.visit(this); }
+    virtual void accept(ast_visitor &visitor) const override {
+        visitor.visit(this);
+    }
 
    private:
-    std::string question_;
-    std::string answer_;
+    ast_text question_;
+    ast_text answer_;
 
-    uint16_t nth_question_ = 0;
+    uint32_t nth_question_ = 0;
 
     ast_chapter *chapter_ = nullptr;
     ast_section *section_ = nullptr;
@@ -120,7 +179,12 @@ class ast_subsection : public ast_node, public has_questions {
 
     const std::string &subsection() const { return subsection_; }
 
-    virtual void accept(ast_visitor &visitor) override { visitor.visit(this); }
+    // whether there are no questions in it
+    bool empty() const { return questions().empty(); }
+
+    virtual void accept(ast_visitor &visitor) const override {
+        visitor.visit(this);
+    }
 
     uint16_t nth_subsection() const { return nth_subsection_; }
 
@@ -151,7 +215,12 @@ class ast_section : public ast_node, public has_questions {
 
     const subsection_vector &subsections() const { return subsections_; }
 
-    virtual void accept(ast_visitor &visitor) override { visitor.visit(this); }
+    // whether there are no questions in it or in its subsections
+    bool empty() const;
+
+    virtual void accept(ast_visitor &visitor) const override {
+        visitor.visit(this);
+    }
 
     uint16_t nth_section() const { return nth_section_; }
 
@@ -185,7 +254,12 @@ class ast_chapter : public ast_node, public has_questions {
 
     const section_vector &sections() const { return sections_; }
 
-    virtual void accept(ast_visitor &visitor) override { visitor.visit(this); }
+    // whether there are no questions in it or in its sections
+    bool empty() const;
+
+    virtual void accept(ast_visitor &visitor) const override {
+        visitor.visit(this);
+    }
 
    private:
     std::string chapter_;
@@ -201,7 +275,9 @@ class ast_root_questions : public ast_node, public has_questions {
 
     ast_root_questions() : ast_node(ast_node_enum::ROOT_QUESTIONS) {}
 
-    virtual void accept(ast_visitor &visitor) override { visitor.visit(this); }
+    virtual void accept(ast_visitor &visitor) const override {
+        visitor.visit(this);
+    }
 };
 
 class ast_root_chapters : public ast_node {
@@ -217,7 +293,9 @@ class ast_root_chapters : public ast_node {
 
     const chapter_vector &chapters() const { return chapters_; }
 
-    virtual void accept(ast_visitor &visitor) override { visitor.visit(this); }
+    virtual void accept(ast_visitor &visitor) const override {
+        visitor.visit(this);
+    }
 
    private:
     chapter_vector chapters_;
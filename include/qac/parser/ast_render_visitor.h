@@ -2,47 +2,68 @@
 #define QAC_AST_RENDER_VISITOR_H
 
 #include <qac/parser/ast_nodes.h>
+#include <qac/util/string_ostream.h>
 
+#include <deque>
+#include <future>
 #include <iostream>
 #include <memory>
-#include <sstream>
-#include <stack>
+#include <string>
+#include <vector>
 
 namespace qac {
 
 class generator;
+class thread_pool;
 
+// Renders the AST straight into the output, only the texts of the question
+// being rendered are kept.
+//
+// With a thread pool the questions are rendered by its workers, a few dozen
+// per task, each into a buffer of its own. The headings are rendered into
+// buffers in between, and the buffers are written in document order. Only a
+// few tasks per worker are in flight at once.
 class ast_render_visitor : public ast_visitor {
    public:
-    using texts_stack = std::stack<std::unique_ptr<std::ostringstream>>;
+    ast_render_visitor(generator *generator, std::ostream &os,
+                       thread_pool *pool = nullptr)
+        : generator_(generator), os_(os), pool_(pool) {}
 
-    ast_render_visitor(generator *generator) : generator_(generator) {}
+    virtual void visit(const ast_chapter *node) override;
+    virtual void visit(const ast_question *node) override;
+    virtual void visit(const ast_root_chapters *node) override;
+    virtual void visit(const ast_root_questions *node) override;
+    virtual void visit(const ast_section *node) override;
+    virtual void visit(const ast_subsection *node) override;
 
-    const std::string &rendered_qa() const { return rendered_qa_; }
+   private:
+    // what is written by the visitor, followed by questions rendered by a
+    // task
+    struct segment {
+        std::string text;
+        std::future<std::string> questions;
+    };
 
-    virtual void visit(ast_chapter *node) override;
-    virtual void visit(ast_question *node) override;
-    virtual void visit(ast_root_chapters *node) override;
-    virtual void visit(ast_root_questions *node) override;
-    virtual void visit(ast_section *node) override;
-    virtual void visit(ast_subsection *node) override;
+    void visit_questions(const has_questions *node);
 
-   private:
-    void push_text_stream() {
-        texts_stack_.push(std::make_unique<std::ostringstream>());
-    }
-    void pop_text_stream() { texts_stack_.pop(); }
-    std::ostringstream &text_stream() { return *texts_stack_.top(); }
+    // where the headings are written to
+    std::ostream &out();
+    void submit_questions();
+    // writes the segments in front of the last keep ones
+    void flush(size_t keep);
 
     generator *generator_;
-    texts_stack texts_stack_;
-    std::string rendered_qa_;
-
-    const bool LOG_VISIT = true;
-    const bool LOG_QUESTION = true;
-    const bool LOG_CHAPTER = true;
-    const bool LOG_SECTION = true;
-    const bool LOG_SUBSECTION = true;
+    std::ostream &os_;
+    // the rendered texts of the question being rendered
+    std::string question_;
+    std::string answer_;
+
+    thread_pool *pool_;
+    std::deque<std::unique_ptr<segment>> segments_;
+    // writes to the text of the last segment
+    std::unique_ptr<string_ostream> segment_os_;
+    // the questions after the last segment's text, not submitted yet
+    std::vector<const ast_question *> questions_;
 };
 
 }  // namespace qac
@@ -1,16 +1,15 @@
 #ifndef QAC_CST_NODES_H
 #define QAC_CST_NODES_H
 
+#include <cstdint>
 #include <iostream>
-#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include <boost/algorithm/string/join.hpp>
-
 namespace qac {
 
-enum class cst_node_enum {
+enum class cst_node_enum : uint8_t {
     ROOT,
     QUESTION,
     QUESTION_TEXT,
@@ -41,6 +40,91 @@ enum class cst_node_enum {
 std::string to_string(const cst_node_enum &nenum);
 std::ostream &operator<<(std::ostream &os, const cst_node_enum &nenum);
 
+enum class cst_alignment_enum : uint8_t { STANDARD, LEFT, CENTER, RIGHT };
+
+class cst_node;
+
+// What the parser reports while it recognises the grammar, in pre-order:
+// open() starts a node as the next child of the innermost open node,
+// add_word() and the setters fill the innermost open node and close()
+// finishes it.
+class cst_builder {
+   public:
+    virtual ~cst_builder() {}
+
+    virtual void open(cst_node_enum type) = 0;
+    virtual void close() = 0;
+    virtual void add_word(std::string_view word) = 0;
+    virtual void set_image(int width, int height) = 0;
+    virtual void set_alignment(cst_alignment_enum alignment) = 0;
+};
+
+// The concrete syntax tree in a few flat arrays. Nodes are addressed by
+// index, the root has index 0. The children of a node are a range of the
+// child index array and the text of TEXT, LATEX_BODY and IMAGE nodes is a
+// span of one text buffer, so the tree is freed at once. add_word() joins the
+// words of a node with blanks right away.
+class cst : public cst_builder {
+   public:
+    using index = uint32_t;
+
+    struct span {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct node {
+        cst_node_enum type;
+        cst_alignment_enum alignment = cst_alignment_enum::STANDARD;
+        uint32_t first_child = 0;
+        uint32_t child_count = 0;
+        span text = {0, 0};
+        int32_t width = -1;
+        int32_t height = -1;
+    };
+
+    bool empty() const { return nodes_.empty(); }
+    size_t size() const { return nodes_.size(); }
+    const node &at(index i) const { return nodes_[i]; }
+    cst_node root() const;
+
+    index child(const node &n, uint32_t nth) const {
+        return children_[n.first_child + nth];
+    }
+
+    std::string_view text(const node &n) const {
+        return std::string_view(text_.data() + n.text.offset, n.text.length);
+    }
+
+    size_t memory_usage() const;
+
+    // builds the tree again, e.g. to turn it into parse events
+    void replay(cst_builder &builder) const;
+
+    // adds the children of the root of a complete tree to the innermost
+    // open node, e.g. the chapters of a deck parsed in parts
+    void append_children(const cst &tree);
+
+    virtual void open(cst_node_enum type) override;
+    virtual void close() override;
+    virtual void add_word(std::string_view word) override;
+    virtual void set_image(int width, int height) override;
+    virtual void set_alignment(cst_alignment_enum alignment) override;
+
+   private:
+    void replay(index i, cst_builder &builder) const;
+
+    std::vector<node> nodes_;
+    std::vector<index> children_;
+    std::string text_;
+    bool first_word_ = true;
+
+    // open nodes and the children of them that are already closed
+    std::vector<index> open_;
+    std::vector<index> pending_;
+    std::vector<size_t> pending_marks_;
+};
+
 class cst_root_questions;
 class cst_root_chapters;
 class cst_question;
@@ -98,258 +182,220 @@ class cst_visitor {
     virtual void visit(cst_table_cell_text *node) = 0;
 };
 
-class has_words {
-   public:
-    void add_word(std::string word) { words_.push_back(word); }
-    std::string words() const { return boost::algorithm::join(words_, " "); }
-
-   private:
-    std::vector<std::string> words_;
-};
+class cst_children;
 
+// A view of one node of a cst. The views of the concrete node types add
+// their accessors, accept() dispatches on the node type.
 class cst_node {
    public:
-    cst_node(cst_node_enum type) : cst_node(type, "") {}
+    cst_node(const cst &tree, cst::index index)
+        : tree_(&tree), index_(index) {}
 
-    cst_node(cst_node_enum type, std::string value)
-        : type_(type), value_(value) {}
+    cst_node_enum type() const { return data().type; }
+    cst::index index() const { return index_; }
 
-    void add_child(std::unique_ptr<cst_node> child) {
-        children_.push_back(std::move(child));
-    }
+    cst_children children() const;
 
-    cst_node_enum type() const { return type_; }
+    void accept(cst_visitor &visitor) const;
 
-    const std::vector<std::unique_ptr<cst_node>> &children() const {
-        return children_;
-    }
+   protected:
+    const cst::node &data() const { return tree_->at(index_); }
 
-    const std::string &value() { return value_; }
+    const cst *tree_;
+    cst::index index_;
+};
 
-    virtual void accept(cst_visitor &visitor) = 0;
+class cst_children {
+   public:
+    class iterator {
+       public:
+        iterator(const cst &tree, const cst::node &parent, uint32_t nth)
+            : tree_(&tree), parent_(&parent), nth_(nth) {}
+
+        cst_node operator*() const {
+            return cst_node(*tree_, tree_->child(*parent_, nth_));
+        }
+        iterator &operator++() {
+            ++nth_;
+            return *this;
+        }
+        bool operator!=(const iterator &other) const {
+            return nth_ != other.nth_;
+        }
+
+       private:
+        const cst *tree_;
+        const cst::node *parent_;
+        uint32_t nth_;
+    };
+
+    cst_children(const cst &tree, const cst::node &parent)
+        : tree_(&tree), parent_(&parent) {}
+
+    size_t size() const { return parent_->child_count; }
+    bool empty() const { return parent_->child_count == 0; }
+
+    cst_node operator[](size_t nth) const {
+        return cst_node(*tree_, tree_->child(*parent_, nth));
+    }
+    cst_node back() const { return (*this)[size() - 1]; }
+
+    iterator begin() const { return iterator(*tree_, *parent_, 0); }
+    iterator end() const {
+        return iterator(*tree_, *parent_, parent_->child_count);
+    }
 
    private:
-    cst_node_enum type_;
-    std::vector<std::unique_ptr<cst_node>> children_;
-    std::string value_;
+    const cst *tree_;
+    const cst::node *parent_;
 };
 
+inline cst_children cst_node::children() const {
+    return cst_children(*tree_, data());
+}
+
+inline cst_node cst::root() const { return cst_node(*this, 0); }
+
 class cst_root_questions : public cst_node {
    public:
-    cst_root_questions() : cst_node(cst_node_enum::ROOT) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_root_chapters : public cst_node {
    public:
-    cst_root_chapters() : cst_node(cst_node_enum::ROOT) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_question : public cst_node {
    public:
-    cst_question() : cst_node(cst_node_enum::QUESTION) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_question_text : public cst_node {
    public:
-    cst_question_text() : cst_node(cst_node_enum::QUESTION_TEXT) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_answer_text : public cst_node {
    public:
-    cst_answer_text() : cst_node(cst_node_enum::ANSWER_TEXT) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
-class cst_text : public cst_node, public has_words {
+class cst_text : public cst_node {
    public:
-    cst_text() : cst_node(cst_node_enum::TEXT) {}
+    using cst_node::cst_node;
 
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    std::string_view words() const { return tree_->text(data()); }
 };
 
 class cst_image : public cst_node {
-private:
-    int width_ = -1;
-    int height_ = -1;
-    std::string source_;
-
-public:
-    cst_image() : cst_node(cst_node_enum::IMAGE) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
-
-    void set_source(std::string source) {
-        source_ = source;
-    }
-
-    void set_source(std::string source, int width, int height) {
-        source_ = source;
-        width_ = width;
-        height_ = height;
-    }
-
-    std::string get_source() const {
-        return source_;
-    }
-
-    int get_width() const {
-        return width_;
-    }
+   public:
+    using cst_node::cst_node;
 
-    int get_height() const {
-        return height_;
-    }
+    std::string get_source() const { return std::string(tree_->text(data())); }
+    int get_width() const { return data().width; }
+    int get_height() const { return data().height; }
 };
 
 class cst_latex : public cst_node {
    public:
-    cst_latex() : cst_node(cst_node_enum::LATEX) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_normal_latex : public cst_node {
    public:
-    cst_normal_latex() : cst_node(cst_node_enum::NORMAL_LATEX) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_centered_latex : public cst_node {
    public:
-    cst_centered_latex() : cst_node(cst_node_enum::CENTERED_LATEX) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
-class cst_latex_body : public cst_node, public has_words {
+class cst_latex_body : public cst_node {
    public:
-    cst_latex_body() : cst_node(cst_node_enum::LATEX_BODY) {}
+    using cst_node::cst_node;
 
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    std::string_view words() const { return tree_->text(data()); }
 };
 
 class cst_unordered_list : public cst_node {
    public:
-    cst_unordered_list() : cst_node(cst_node_enum::UNORDERED_LIST) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_unordered_list_item : public cst_node {
    public:
-    cst_unordered_list_item() : cst_node(cst_node_enum::UNORDERED_LIST_ITEM) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_ordered_list : public cst_node {
    public:
-    cst_ordered_list() : cst_node(cst_node_enum::ORDERED_LIST) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_ordered_list_item : public cst_node {
    public:
-    cst_ordered_list_item() : cst_node(cst_node_enum::ORDERED_LIST_ITEM) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_list_item_text : public cst_node {
    public:
-    cst_list_item_text() : cst_node(cst_node_enum::LIST_ITEM_TEXT) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_bold : public cst_node {
    public:
-    cst_bold() : cst_node(cst_node_enum::BOLD) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_underlined : public cst_node {
    public:
-    cst_underlined() : cst_node(cst_node_enum::UNDERLINED) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_code : public cst_node {
    public:
-    cst_code() : cst_node(cst_node_enum::CODE) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_chapter : public cst_node {
    public:
-    cst_chapter() : cst_node(cst_node_enum::CHAPTER) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_section : public cst_node {
    public:
-    cst_section() : cst_node(cst_node_enum::SECTION) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_subsection : public cst_node {
    public:
-    cst_subsection() : cst_node(cst_node_enum::SUBSECTION) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_table : public cst_node {
    public:
-    cst_table() : cst_node(cst_node_enum::TABLE) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_table_row : public cst_node {
    public:
-    cst_table_row() : cst_node(cst_node_enum::TABLE_ROW) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 class cst_table_cell : public cst_node {
    public:
-    cst_table_cell() : cst_node(cst_node_enum::TABLE_CELL) {}
-
-    enum class alignment_enum { STANDARD, LEFT, CENTER, RIGHT };
+    using alignment_enum = cst_alignment_enum;
 
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 
-    alignment_enum alignment() const { return alignment_; }
-
-    void alignment(alignment_enum alignment) { alignment_ = alignment; }
-
-   private:
-    alignment_enum alignment_ = alignment_enum::STANDARD;
+    alignment_enum alignment() const { return data().alignment; }
 };
 
 class cst_table_cell_text : public cst_node {
    public:
-    cst_table_cell_text() : cst_node(cst_node_enum::TABLE_CELL_TEXT) {}
-
-    virtual void accept(cst_visitor &visitor) override { visitor.visit(this); }
+    using cst_node::cst_node;
 };
 
 }  // namespace qac
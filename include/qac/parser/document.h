@@ -0,0 +1,68 @@
+#ifndef QAC_DOCUMENT_H
+#define QAC_DOCUMENT_H
+
+#include <qac/lexer/lexer.h>
+#include <qac/parser/cst_nodes.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace qac {
+
+// A deck which is kept in memory and edited, e.g. by an editor. The text is
+// split into parts at the questions and headings which start a line, every
+// part is lexed and parsed on its own. An edit only lexes and parses the
+// parts it touches again, the trees of all other parts are reused.
+//
+// FILE: lines are resolved like lexer::lex() does. A part including files is
+// parsed together with the whole deck, as is a part which doesn't end where
+// the next one starts.
+class document {
+   public:
+    explicit document(std::string_view text = "");
+    ~document();
+
+    // Replaces length bytes at offset with text.
+    void edit(size_t offset, size_t length, std::string_view text);
+
+    // The tree of the whole deck, as parser::parse() builds it. Throws a
+    // parse_error with the errors of all parts.
+    cst tree() const;
+
+    std::string text() const;
+    size_t size() const { return offsets_.back(); }
+
+    // Part 0 is the text in front of the first question or heading, it may
+    // be empty.
+    size_t parts() const { return parts_.size(); }
+    size_t part_at(size_t offset) const;
+    size_t part_offset(size_t part) const { return offsets_[part]; }
+    const std::string &part_text(size_t part) const;
+    const cst &part_tree(size_t part) const;
+
+    // the parts parsed by the last edit, or by the constructor
+    size_t reparsed() const { return reparsed_; }
+
+   private:
+    struct part;
+    class part_source;
+
+    std::vector<std::unique_ptr<part>> split(const std::string &text,
+                                             const std::vector<token> &tokens,
+                                             bool preamble) const;
+    void parse(size_t part);
+    void update_offsets(size_t from);
+    cst parse_all() const;
+
+    std::vector<std::unique_ptr<part>> parts_;
+    // the byte offset and the first line of every part, and the end
+    std::vector<size_t> offsets_;
+    std::vector<uint32_t> lines_;
+    size_t reparsed_ = 0;
+};
+}
+
+#endif  // QAC_DOCUMENT_H
@@ -0,0 +1,93 @@
+#ifndef QAC_PARSE_HANDLER_H
+#define QAC_PARSE_HANDLER_H
+
+#include <qac/parser/cst_nodes.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace qac {
+
+// Callbacks of the event-driven parse mode, called in document order. The
+// strings are only valid during the call. Every callback does nothing by
+// default, so a handler overrides just the events it needs.
+class parse_handler {
+   public:
+    virtual ~parse_handler() {}
+
+    virtual void on_document_begin() {}
+    virtual void on_document_end() {}
+
+    virtual void on_chapter_begin(std::string_view caption) {}
+    virtual void on_chapter_end() {}
+    virtual void on_section_begin(std::string_view caption) {}
+    virtual void on_section_end() {}
+    virtual void on_subsection_begin(std::string_view caption) {}
+    virtual void on_subsection_end() {}
+
+    virtual void on_question_begin() {}
+    virtual void on_question_end() {}
+    virtual void on_question_text_begin() {}
+    virtual void on_question_text_end() {}
+    virtual void on_answer_text_begin() {}
+    virtual void on_answer_text_end() {}
+
+    virtual void on_text(std::string_view words) {}
+    virtual void on_image(std::string_view source, int width, int height) {}
+    virtual void on_latex(std::string_view body, bool centered) {}
+    virtual void on_bold(std::string_view words) {}
+    virtual void on_underlined(std::string_view words) {}
+    virtual void on_code(std::string_view words) {}
+
+    virtual void on_unordered_list_begin() {}
+    virtual void on_unordered_list_end() {}
+    virtual void on_ordered_list_begin() {}
+    virtual void on_ordered_list_end() {}
+    virtual void on_list_item_begin() {}
+    virtual void on_list_item_end() {}
+
+    virtual void on_table_begin() {}
+    virtual void on_table_end() {}
+    virtual void on_table_row_begin() {}
+    virtual void on_table_row_end() {}
+    virtual void on_table_cell_begin(cst_alignment_enum alignment) {}
+    virtual void on_table_cell_end() {}
+};
+
+// Turns what the parser builds into parse_handler events. Only the open
+// nodes are kept, so the memory doesn't grow with the deck. Replaying a cst
+// into it gives the same events as parsing the deck.
+class parse_event_builder : public cst_builder {
+   public:
+    explicit parse_event_builder(parse_handler &handler)
+        : handler_(handler) {}
+
+    virtual void open(cst_node_enum type) override;
+    virtual void close() override;
+    virtual void add_word(std::string_view word) override;
+    virtual void set_image(int width, int height) override;
+    virtual void set_alignment(cst_alignment_enum alignment) override;
+
+   private:
+    struct frame {
+        cst_node_enum type;
+        cst_alignment_enum alignment = cst_alignment_enum::STANDARD;
+        // chapters and cells begin once their caption or text starts
+        bool begun = false;
+    };
+
+    void text_closed();
+
+    parse_handler &handler_;
+    std::vector<frame> open_;
+
+    // the words of the open TEXT, LATEX_BODY or IMAGE node
+    std::string words_;
+    bool first_word_ = true;
+    int width_ = -1;
+    int height_ = -1;
+};
+}
+
+#endif  // QAC_PARSE_HANDLER_H
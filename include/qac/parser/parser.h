@@ -1,54 +1,195 @@
 #ifndef QAC_PARSER_H
 #define QAC_PARSER_H
 
-#include <memory>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include <qac/lexer/lexer.h>
+#include <qac/lexer/token_source.h>
 #include <qac/parser/cst_nodes.h>
+#include <qac/parser/parse_handler.h>
 
 namespace qac {
 
+// A set of token kinds as a bit mask, e.g. the tokens a rule starts with.
+class token_set {
+   public:
+    constexpr token_set(std::initializer_list<token_enum> tokens) {
+        for (token_enum token : tokens) {
+            bits_ |= bit(token);
+        }
+    }
+
+    constexpr bool contains(token_enum token) const {
+        return bits_ & bit(token);
+    }
+
+    constexpr token_set operator|(token_set other) const {
+        token_set set = *this;
+        set.bits_ |= other.bits_;
+        return set;
+    }
+
+   private:
+    static constexpr uint32_t bit(token_enum token) {
+        return uint32_t(1) << static_cast<unsigned>(token);
+    }
+
+    uint32_t bits_ = 0;
+};
+
+static_assert(static_cast<unsigned>(token_enum::IMAGE) < 32,
+              "a token_set holds 32 token kinds");
+
+// Every problem the parser found in a deck, what() is the first one.
+class parse_error : public std::runtime_error {
+   public:
+    explicit parse_error(std::vector<std::string> messages)
+        : std::runtime_error(messages.front()),
+          messages_(std::move(messages)) {}
+
+    const std::vector<std::string> &messages() const { return messages_; }
+
+   private:
+    std::vector<std::string> messages_;
+};
+
+// The parts of a deck which were parsed on their own, see
+// parser::parse_part(). Every token is the first one of a part, or of the
+// whitespace in front of the first question or heading. After next() the
+// part of the returned token is the current one.
+class parsed_parts : public token_source {
+   public:
+    virtual const cst &part_tree() = 0;
+    virtual const std::vector<std::string> &part_errors() = 0;
+};
+
+// After an error the parser skips to the next question, chapter, section or
+// subsection and goes on, so one pass finds all errors of a deck. parse()
+// then throws a parse_error. The tree or the events stop at the first error.
 class parser {
    public:
-    std::unique_ptr<cst_node> parse(const std::vector<token> &tokens);
+    cst parse(const std::vector<token> &tokens);
+    cst parse(token_source &tokens);
+
+    // Calls the handler while the rules are recognised, no tree is built.
+    void parse(const std::vector<token> &tokens, parse_handler &handler);
+    void parse(token_source &tokens, parse_handler &handler);
+
+    // Parses a question or a heading with the questions on its line, up to
+    // stop, which is not consumed. The errors are returned instead of thrown.
+    // Returns false if the part doesn't end at stop, e.g. because an included
+    // file brought in a heading, then it can't be assembled.
+    bool parse_part(token_source &tokens, const token *stop, cst &tree,
+                    std::vector<std::string> &errors);
+
+    // Joins the trees of the parts into the tree of the deck. The tree and
+    // the errors are the same as if the whole deck was parsed.
+    cst parse(parsed_parts &parts);
+
+    // A deck of chapters in a token vector is parsed on this many threads,
+    // one chapter per task, 0 uses all hardware threads. The tree and the
+    // errors are the same as with a single thread.
+    void set_threads(unsigned threads) { threads_ = threads; }
+
+    // file names for diagnostics, indexed by token::file(). The names are
+    // only read on errors, so they may still grow while parsing.
+    void set_files(const std::vector<std::string> &files) { files_ = &files; }
 
    private:
+    // thrown once an error is recorded, to get back to a rule that recovers
+    struct recovery {};
+
+    // a builder which drops everything, used after the first error
+    class discarding_builder : public cst_builder {
+       public:
+        virtual void open(cst_node_enum type) override {}
+        virtual void close() override {}
+        virtual void add_word(std::string_view word) override {}
+        virtual void set_image(int width, int height) override {}
+        virtual void set_alignment(cst_alignment_enum alignment) override {}
+    };
+
+    // Runs a rule. After an error the nodes the rule opened are dropped and
+    // the tokens up to the next question or heading are skipped.
+    template <typename Rule>
+    void recoverable(Rule rule) {
+        size_t depth = child_counts_.size();
+        try {
+            rule();
+        } catch (recovery &) {
+            child_counts_.resize(depth);
+            skip_to_heading();
+        }
+    }
+
+    void open_node(cst_node_enum type);
+    void close_node();
+    void error(const std::string &message);
+    void skip_to_heading();
+    void expect_heading();
+    void append_part(token_enum token);
+
     bool match(token_enum token);
+    token advance();
     token_enum lookahead();
     void skip_whitespace();
     void no_rule_found(cst_node_enum nenum);
+    std::string location();
+
+    void parse_root();
+    void parse_deck(token_enum deck);
+    void parse_questions();
+    void parse_question();
+    void parse_question_text();
+    void parse_answer_text();
+    void parse_elements(token_set first);
+    void parse_text();
+    void parse_latex();
+    void parse_normal_latex();
+    void parse_centered_latex();
+    void parse_latex_body();
+    void parse_unordered_list();
+    void parse_unordered_list_item();
+    void parse_ordered_list();
+    void parse_ordered_list_item();
+    void parse_list_item_text();
+    void parse_bold();
+    void parse_underlined();
+    void parse_code();
+    void parse_heading(token_enum heading);
+    void parse_chapter();
+    void parse_section();
+    void parse_subsection();
+    void parse_table();
+    void parse_table_row();
+    bool parse_table_cell();
+    void parse_table_cell_text();
+    void parse_image();
+
+    void build(token_source &tokens, cst_builder &builder,
+               parsed_parts *parts = nullptr);
+    cst parse_chapters(const std::vector<token> &tokens,
+                       const std::vector<size_t> &chapters);
 
-    std::unique_ptr<cst_node> parse_root();
-    std::unique_ptr<cst_node> parse_question(bool optional = false);
-    std::unique_ptr<cst_node> parse_question_text(bool optional = false);
-    std::unique_ptr<cst_node> parse_answer_text(bool optional = false);
-    std::unique_ptr<cst_node> parse_text();
-    std::unique_ptr<cst_node> parse_latex();
-    std::unique_ptr<cst_node> parse_normal_latex();
-    std::unique_ptr<cst_node> parse_centered_latex();
-    std::unique_ptr<cst_node> parse_latex_body();
-    std::unique_ptr<cst_node> parse_unordered_list();
-    std::unique_ptr<cst_node> parse_unordered_list_item(bool optional = false);
-    std::unique_ptr<cst_node> parse_ordered_list();
-    std::unique_ptr<cst_node> parse_ordered_list_item(bool optional = false);
-    std::unique_ptr<cst_node> parse_list_item_text(bool optional = false);
-    std::unique_ptr<cst_node> parse_bold();
-    std::unique_ptr<cst_node> parse_underlined();
-    std::unique_ptr<cst_node> parse_code();
-    std::unique_ptr<cst_node> parse_chapter(bool optional = false);
-    std::unique_ptr<cst_node> parse_section(bool optional = false);
-    std::unique_ptr<cst_node> parse_subsection(bool optional = false);
-    std::unique_ptr<cst_node> parse_table();
-    std::unique_ptr<cst_node> parse_table_row(bool optional = false);
-    std::unique_ptr<cst_node> parse_table_cell(bool optional = false);
-    std::unique_ptr<cst_node> parse_table_cell_text();
-    std::unique_ptr<cst_node> parse_image();
-
-    std::vector<token>::const_iterator current_;
-    std::vector<token>::const_iterator lookahead_;
-    std::vector<token>::const_iterator end_;
-
-    uint16_t cur_line_ = 1;
+    token_source *tokens_ = nullptr;
+    cst_builder *builder_ = nullptr;
+    discarding_builder discard_;
+    // the children of the open nodes so far
+    std::vector<uint32_t> child_counts_;
+    std::vector<std::string> errors_;
+    // lookahead() ends the input at this token, the first one of the next
+    // part
+    const token *stop_ = nullptr;
+    // the token lookahead() returned, until a token is consumed
+    const token *ahead_ = nullptr;
+    // set while assembling parts, their first tokens stand for their trees
+    parsed_parts *parts_ = nullptr;
+    unsigned threads_ = 1;
+    token current_ = token(token_enum::END_OF_FILE, "", 1);
+    const std::vector<std::string> *files_ = nullptr;
 };
 }
 
@@ -0,0 +1,46 @@
+#ifndef QAC_STRING_OSTREAM_H
+#define QAC_STRING_OSTREAM_H
+
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+namespace qac {
+
+// An output stream which appends to a string right away, it has no buffer of
+// its own. The string can be read and changed between the writes.
+class string_ostream : public std::ostream {
+   public:
+    explicit string_ostream(std::string &string)
+        : std::ostream(nullptr), buffer_(string) {
+        rdbuf(&buffer_);
+    }
+
+   private:
+    class string_buffer : public std::streambuf {
+       public:
+        explicit string_buffer(std::string &string) : string_(string) {}
+
+       protected:
+        virtual int_type overflow(int_type c) override {
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                string_ += traits_type::to_char_type(c);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        virtual std::streamsize xsputn(const char *s,
+                                       std::streamsize n) override {
+            string_.append(s, n);
+            return n;
+        }
+
+       private:
+        std::string &string_;
+    };
+
+    string_buffer buffer_;
+};
+}
+
+#endif  // QAC_STRING_OSTREAM_H
@@ -0,0 +1,53 @@
+#ifndef QAC_THREAD_POOL_H
+#define QAC_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace qac {
+
+// Fixed number of worker threads running submitted tasks in FIFO order.
+// The destructor finishes all queued tasks before joining the workers.
+class thread_pool {
+   public:
+    // 0 starts one worker per hardware thread
+    explicit thread_pool(unsigned threads);
+    ~thread_pool();
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    std::size_t size() const { return workers_.size(); }
+
+    template <typename F>
+    auto submit(F task) -> std::future<decltype(task())> {
+        using result_type = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<result_type()>>(
+            std::move(task));
+        std::future<result_type> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push([packaged] { (*packaged)(); });
+        }
+        condition_.notify_one();
+        return result;
+    }
+
+   private:
+    void work();
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stopping_ = false;
+};
+}
+
+#endif  // QAC_THREAD_POOL_H
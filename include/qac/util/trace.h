@@ -0,0 +1,90 @@
+#ifndef QAC_TRACE_H
+#define QAC_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "qac_config.h"
+
+namespace qac {
+
+// What a trace message is about. Components are enabled at runtime.
+enum class trace_component : uint8_t { LEXER, PARSER, VISITOR };
+
+// The detail of a trace message. Messages above QAC_TRACE_LEVEL are not
+// compiled in, so with the default level 0 tracing costs nothing.
+enum class trace_level : uint8_t { RULE = 1, TOKEN = 2 };
+
+constexpr bool trace_compiled(trace_level level) {
+    return static_cast<int>(level) <= QAC_TRACE_LEVEL;
+}
+
+// Keeps the latest messages of the enabled components in a ring buffer,
+// instead of writing every one of them out while lexing or parsing.
+class trace_buffer {
+   public:
+    static trace_buffer &instance();
+
+    // comma separated component names: lexer, parser, visitor or all
+    void enable(const std::string &components);
+    bool enabled(trace_component component) const {
+        return mask_.load(std::memory_order_relaxed) & bit(component);
+    }
+
+    void set_capacity(size_t capacity);
+    void record(trace_component component, std::string message);
+    void clear();
+
+    // the buffered messages, oldest first
+    void dump(std::ostream &os);
+
+   private:
+    struct entry {
+        trace_component component;
+        std::string message;
+    };
+
+    static uint32_t bit(trace_component component) {
+        return 1u << static_cast<int>(component);
+    }
+
+    std::atomic<uint32_t> mask_{0};
+
+    std::mutex mutex_;
+    std::vector<entry> entries_;
+    size_t next_ = 0;
+    size_t capacity_ = 1 << 16;
+};
+
+// Collects one message and records it when it goes out of scope.
+class trace_message {
+   public:
+    explicit trace_message(trace_component component)
+        : component_(component) {}
+    ~trace_message() {
+        trace_buffer::instance().record(component_, stream_.str());
+    }
+
+    std::ostream &stream() { return stream_; }
+
+   private:
+    trace_component component_;
+    std::ostringstream stream_;
+};
+
+}  // namespace qac
+
+// QAC_TRACE(PARSER, RULE) << "parse_question";
+#define QAC_TRACE(component, level)                                   \
+    if constexpr (!::qac::trace_compiled(::qac::trace_level::level)) { \
+    } else if (!::qac::trace_buffer::instance().enabled(              \
+                   ::qac::trace_component::component)) {              \
+    } else                                                            \
+        ::qac::trace_message(::qac::trace_component::component).stream()
+
+#endif  // QAC_TRACE_H
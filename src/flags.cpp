@@ -3,8 +3,24 @@
 DEFINE_bool(listgenerators, false, "List available generators.");
 DEFINE_bool(printcst, false, "Print parse tree.");
 DEFINE_bool(printtokens, false, "Print lexing tokens.");
-DEFINE_string(generator, "html", "Used generator.");
+DEFINE_bool(printstats, false, "Print token statistics.");
+DEFINE_bool(intern, false,
+            "Intern token values into a symbol table before parsing.");
+DEFINE_string(generator, "html",
+              "Used generators, separated by commas. NAME:OUTPUT writes "
+              "the output of a generator to its own file.");
 DEFINE_string(output, "", "File to write output to.");
+DEFINE_int32(threads, 1,
+             "Number of threads used to lex large inputs, to parse "
+             "chapters and to render questions (0 uses all cores).");
+DEFINE_string(cache_dir, "",
+              "Directory to cache lexed files in, unchanged files are not "
+              "lexed again.");
+DEFINE_string(trace, "",
+              "Comma separated components to trace: lexer, parser, visitor "
+              "or all. Needs a build with QAC_TRACE_LEVEL above 0.");
+DEFINE_int32(trace_size, 65536,
+             "Number of latest trace messages printed at the end.");
 
 DEFINE_string(chapter, "Chapter", "The word chapter used for rendering.");
 DEFINE_string(section, "Section", "The word section used for rendering.");
@@ -35,28 +35,29 @@ void anki_generator::render_underlined(std::ostream &os,
     os << "<span style=\"text-decoration: underline\">" << text << "</span>";
 }
 
-void anki_generator::render_chapter(std::ostream &os,
-                                    const std::string &caption,
-                                    const std::string &questions,
-                                    const std::string &sections,
-                                    const ast_chapter *chapter) {
-    os << questions << sections;
-}
+void anki_generator::render_chapter_begin(std::ostream &os,
+                                          const ast_chapter *chapter) {}
 
-void anki_generator::render_section(std::ostream &os,
-                                    const std::string &caption,
-                                    const std::string &questions,
-                                    const std::string &subsections,
-                                    const ast_section *section) {
-    os << questions << subsections;
-}
+void anki_generator::render_chapter_sections(std::ostream &os,
+                                             const ast_chapter *chapter) {}
 
-void anki_generator::render_subsection(std::ostream &os,
-                                       const std::string &caption,
-                                       const std::string &questions,
-                                       const ast_subsection *subsection) {
-    os << questions;
-}
+void anki_generator::render_chapter_end(std::ostream &os,
+                                        const ast_chapter *chapter) {}
+
+void anki_generator::render_section_begin(std::ostream &os,
+                                          const ast_section *section) {}
+
+void anki_generator::render_section_subsections(std::ostream &os,
+                                                const ast_section *section) {}
+
+void anki_generator::render_section_end(std::ostream &os,
+                                        const ast_section *section) {}
+
+void anki_generator::render_subsection_begin(
+    std::ostream &os, const ast_subsection *subsection) {}
+
+void anki_generator::render_subsection_end(std::ostream &os,
+                                           const ast_subsection *subsection) {}
 
 void anki_generator::render_question(std::ostream &os,
                                      const std::string &question,
@@ -94,39 +95,31 @@ void anki_generator::render_question(std::ostream &os,
     os << question << "\t" << answer << "\t" << tag_string << "\n";
 }
 
-void anki_generator::render_document(std::ostream &os,
-                                     const std::string &body) {
-    os << body;
-}
+void anki_generator::render_document_begin(std::ostream &os) {}
+
+void anki_generator::render_document_end(std::ostream &os) {}
 
-void anki_generator::render_table(std::ostream &os, const std::string &rows) {
-    os << "<table style=\"border: 1px solid black; border-collapse: collapse\">"
-       << rows << "</table>";
+void anki_generator::render_table_begin(std::ostream &os) {
+    os << "<table style=\"border: 1px solid black; border-collapse: "
+          "collapse\">";
 }
 
-void anki_generator::render_table_cell(std::ostream &os,
-                                       const std::string &cell_body) {
-    os << "<td style=\"border: 1px solid black; padding: 1em\">" << cell_body
-       << "</td>";
+void anki_generator::render_table_cell_begin(std::ostream &os) {
+    os << "<td style=\"border: 1px solid black; padding: 1em\">";
 }
 
-void anki_generator::render_table_cell_left_aligned(
-    std::ostream &os, const std::string &cell_body) {
+void anki_generator::render_table_cell_left_aligned_begin(std::ostream &os) {
     os << "<td style=\"border: 1px solid black; text-align: left; padding: "
-          "1em\">"
-       << cell_body << "</td>";
+          "1em\">";
 }
 
-void anki_generator::render_table_cell_right_aligned(
-    std::ostream &os, const std::string &cell_body) {
+void anki_generator::render_table_cell_right_aligned_begin(std::ostream &os) {
     os << "<td style=\"border: 1px solid black; text-align: right; padding: "
-          "1em\">"
-       << cell_body << "</td>";
+          "1em\">";
 }
 
-void anki_generator::render_table_cell_center_aligned(
-    std::ostream &os, const std::string &cell_body) {
+void anki_generator::render_table_cell_center_aligned_begin(
+    std::ostream &os) {
     os << "<td style=\"border: 1px solid black; text-align: center; padding: "
-          "1em\">"
-       << cell_body << "</td>";
+          "1em\">";
 }
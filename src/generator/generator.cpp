@@ -1,22 +1,197 @@
 #include <qac/generator/generator.h>
-#include <qac/parser/cst_to_ast_visitor.h>
+#include <qac/parser/ast_builder.h>
 #include <qac/parser/ast_render_visitor.h>
+#include <qac/util/string_ostream.h>
+#include <qac/util/thread_pool.h>
 
 #include <iostream>
+#include <utility>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
 
 using namespace std;
 using namespace qac;
 
-void generator::generate(cst_node *cst_root, std::ostream &os) {
-    cst_to_ast_visitor converter(this);
-    cst_root->accept(converter);
-    auto ast_root = converter.root();
+void generator::generate(const cst &tree, std::ostream &os) {
+    ast_builder builder;
+    parse_event_builder events(builder);
+    tree.replay(events);
+    render(*builder.root(), os);
+}
+
+void generator::generate(parser &parser, token_source &tokens,
+                         std::ostream &os) {
+    ast_builder builder;
+    parser.parse(tokens, builder);
+    render(*builder.root(), os);
+}
+
+void generator::render(const ast_node &root, std::ostream &os) {
+    if (threads_ == 1) {
+        ast_render_visitor renderer(this, os);
+        root.accept(renderer);
+        return;
+    }
 
-    ast_render_visitor renderer(this);
-    ast_root->accept(renderer);
-    os << renderer.rendered_qa();
+    thread_pool pool(threads_);
+    ast_render_visitor renderer(this, os, &pool);
+    root.accept(renderer);
 }
 
+void generator::render_chapter_sections(std::ostream &os,
+                                        const ast_chapter *chapter) {}
+
+void generator::render_section_subsections(std::ostream &os,
+                                           const ast_section *section) {}
+
+namespace {
+
+// trims the text from begin on
+void trim_from(string &text, size_t begin) {
+    auto is_space = boost::algorithm::is_space();
+    size_t end = text.size();
+    while (end > begin && is_space(text[end - 1])) {
+        --end;
+    }
+    size_t first = begin;
+    while (first < end && is_space(text[first])) {
+        ++first;
+    }
+    text.resize(end);
+    text.erase(begin, first - begin);
+}
+}
+
+// The lists and tables are rendered around their content right where it is
+// written, their content is trimmed in place when they end.
+void generator::render_text(std::string &out, const ast_text &text) {
+    string_ostream os(out);
+    // the open elements, with where their content starts
+    vector<pair<ast_text_enum, size_t>> open;
+    auto parent = [&] {
+        return open.empty() ? ast_text_enum::END : open.back().first;
+    };
+
+    for (const ast_text::element &e : text.elements()) {
+        switch (e.type) {
+            case ast_text_enum::TEXT:
+                out.append(text.words(e));
+                out += ' ';
+                break;
+            case ast_text_enum::IMAGE:
+                render_image(os, string(text.words(e)), e.width, e.height);
+                out += ' ';
+                break;
+            case ast_text_enum::LATEX:
+                render_normal_latex(os, string(text.words(e)));
+                out += ' ';
+                break;
+            case ast_text_enum::CENTERED_LATEX:
+                render_centered_latex(os, string(text.words(e)));
+                out += ' ';
+                break;
+            case ast_text_enum::BOLD:
+                render_bold(os, string(text.words(e)));
+                out += ' ';
+                break;
+            case ast_text_enum::UNDERLINED:
+                render_underlined(os, string(text.words(e)));
+                out += ' ';
+                break;
+            case ast_text_enum::CODE:
+                render_code(os, string(text.words(e)));
+                out += ' ';
+                break;
+
+            case ast_text_enum::END: {
+                auto [type, begin] = open.back();
+                open.pop_back();
+                trim_from(out, begin);
+                render_end(os, type, parent());
+                break;
+            }
+
+            default:
+                render_begin(os, e, parent());
+                open.emplace_back(e.type, out.size());
+                break;
+        }
+    }
+}
+
+void generator::render_begin(std::ostream &os, const ast_text::element &e,
+                             ast_text_enum parent) {
+    switch (e.type) {
+        case ast_text_enum::UNORDERED_LIST:
+            render_unordered_list_begin(os);
+            break;
+        case ast_text_enum::ORDERED_LIST:
+            render_ordered_list_begin(os);
+            break;
+        case ast_text_enum::LIST_ITEM:
+            if (parent == ast_text_enum::ORDERED_LIST) {
+                render_ordered_list_item_begin(os);
+            } else {
+                render_unordered_list_item_begin(os);
+            }
+            break;
+        case ast_text_enum::TABLE:
+            render_table_begin(os);
+            break;
+        case ast_text_enum::TABLE_ROW:
+            render_table_row_begin(os);
+            break;
+        case ast_text_enum::TABLE_CELL:
+            switch (e.alignment) {
+                case cst_alignment_enum::STANDARD:
+                    render_table_cell_begin(os);
+                    break;
+                case cst_alignment_enum::LEFT:
+                    render_table_cell_left_aligned_begin(os);
+                    break;
+                case cst_alignment_enum::CENTER:
+                    render_table_cell_center_aligned_begin(os);
+                    break;
+                case cst_alignment_enum::RIGHT:
+                    render_table_cell_right_aligned_begin(os);
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void generator::render_end(std::ostream &os, ast_text_enum type,
+                           ast_text_enum parent) {
+    switch (type) {
+        case ast_text_enum::UNORDERED_LIST:
+            render_unordered_list_end(os);
+            break;
+        case ast_text_enum::ORDERED_LIST:
+            render_ordered_list_end(os);
+            break;
+        case ast_text_enum::LIST_ITEM:
+            if (parent == ast_text_enum::ORDERED_LIST) {
+                render_ordered_list_item_end(os);
+            } else {
+                render_unordered_list_item_end(os);
+            }
+            break;
+        case ast_text_enum::TABLE:
+            render_table_end(os);
+            break;
+        case ast_text_enum::TABLE_ROW:
+            render_table_row_end(os);
+            break;
+        case ast_text_enum::TABLE_CELL:
+            render_table_cell_end(os);
+            break;
+        default:
+            break;
+    }
+}
 void generator::render_normal_latex(std::ostream &os, const std::string &text) {
     os << "\\(" << text << "\\)";
 }
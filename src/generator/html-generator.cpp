@@ -31,62 +31,83 @@ void html_generator::render_code(std::ostream &os, const std::string &text) {
     os << "<code>" << text << "</code>";
 }
 
-void html_generator::render_unordered_list(std::ostream &os,
-                                           const std::string &text) {
-    os << "<ul>" << text << "</ul>";
+void html_generator::render_unordered_list_begin(std::ostream &os) {
+    os << "<ul>";
 }
 
-void html_generator::render_unordered_list_item(std::ostream &os,
-                                                const std::string &text) {
-    os << "<li>" << text << "</li>";
+void html_generator::render_unordered_list_end(std::ostream &os) {
+    os << "</ul>";
 }
 
-void html_generator::render_ordered_list(std::ostream &os,
-                                         const std::string &text) {
-    os << "<ol>" << text << "</ol>";
+void html_generator::render_unordered_list_item_begin(std::ostream &os) {
+    os << "<li>";
 }
 
-void html_generator::render_ordered_list_item(std::ostream &os,
-                                              const std::string &text) {
-    render_unordered_list_item(os, text);
+void html_generator::render_unordered_list_item_end(std::ostream &os) {
+    os << "</li>";
 }
 
-void html_generator::render_chapter(std::ostream &os,
-                                    const std::string &caption,
-                                    const std::string &questions,
-                                    const std::string &sections,
-                                    const ast_chapter *chapter) {
-    if (!caption.empty() && (!questions.empty() || !sections.empty())) {
-        os << "<div class=\"qa_chapter\">\n"
-           << "    <h1><span>" << FLAGS_chapter << " " << chapter->nth_chapter()
-           << "</span>" << caption << "</h1>\n\n" << questions << "\n"
-           << sections << "</div>\n\n";
-    }
+void html_generator::render_ordered_list_begin(std::ostream &os) {
+    os << "<ol>";
 }
 
-void html_generator::render_section(std::ostream &os,
-                                    const std::string &caption,
-                                    const std::string &questions,
-                                    const std::string &subsections,
-                                    const ast_section *section) {
-    if (!caption.empty() && (!questions.empty() || !subsections.empty())) {
-        os << "<div class=\"qa_section\">\n"
-           << "    <h2><span>" << FLAGS_section << " " << section->nth_section()
-           << "</span>" << caption << "</h2>\n\n" << questions << "\n"
-           << subsections << "</div>\n";
-    }
+void html_generator::render_ordered_list_end(std::ostream &os) {
+    os << "</ol>";
 }
 
-void html_generator::render_subsection(std::ostream &os,
-                                       const std::string &caption,
-                                       const std::string &questions,
-                                       const ast_subsection *subsection) {
-    if (!caption.empty() && !questions.empty()) {
-        os << "<div class=\"qa_subsection\">\n"
-           << "    <h3><span>" << FLAGS_subsection << " "
-           << subsection->nth_subsection() << "</span>" << caption
-           << "</h2>\n\n" << questions << "</div>\n";
-    }
+void html_generator::render_ordered_list_item_begin(std::ostream &os) {
+    render_unordered_list_item_begin(os);
+}
+
+void html_generator::render_ordered_list_item_end(std::ostream &os) {
+    render_unordered_list_item_end(os);
+}
+
+void html_generator::render_chapter_begin(std::ostream &os,
+                                          const ast_chapter *chapter) {
+    os << "<div class=\"qa_chapter\">\n"
+       << "    <h1><span>" << FLAGS_chapter << " " << chapter->nth_chapter()
+       << "</span>" << chapter->chapter() << "</h1>\n\n";
+}
+
+void html_generator::render_chapter_sections(std::ostream &os,
+                                             const ast_chapter *chapter) {
+    os << "\n";
+}
+
+void html_generator::render_chapter_end(std::ostream &os,
+                                        const ast_chapter *chapter) {
+    os << "</div>\n\n";
+}
+
+void html_generator::render_section_begin(std::ostream &os,
+                                          const ast_section *section) {
+    os << "<div class=\"qa_section\">\n"
+       << "    <h2><span>" << FLAGS_section << " " << section->nth_section()
+       << "</span>" << section->section() << "</h2>\n\n";
+}
+
+void html_generator::render_section_subsections(std::ostream &os,
+                                                const ast_section *section) {
+    os << "\n";
+}
+
+void html_generator::render_section_end(std::ostream &os,
+                                        const ast_section *section) {
+    os << "</div>\n";
+}
+
+void html_generator::render_subsection_begin(
+    std::ostream &os, const ast_subsection *subsection) {
+    os << "<div class=\"qa_subsection\">\n"
+       << "    <h3><span>" << FLAGS_subsection << " "
+       << subsection->nth_subsection() << "</span>" << subsection->subsection()
+       << "</h2>\n\n";
+}
+
+void html_generator::render_subsection_end(std::ostream &os,
+                                           const ast_subsection *subsection) {
+    os << "</div>\n";
 }
 
 void html_generator::render_question(std::ostream &os,
@@ -100,8 +121,7 @@ void html_generator::render_question(std::ostream &os,
        << "</div>\n";
 }
 
-void html_generator::render_document(std::ostream &os,
-                                     const std::string &body) {
+void html_generator::render_document_begin(std::ostream &os) {
     std::string font = "        <link href='https://fonts.googleapis.com/css?family=Open+Sans:400,300,600' rel='stylesheet' type='text/css'>\n";
     std::string mathjax_src = "http://cdn.mathjax.org/mathjax/latest/";
 
@@ -187,35 +207,41 @@ void html_generator::render_document(std::ostream &os,
        << "            }\n"
        << "        </style>\n"
        << "    </head>\n"
-       << "    <body>\n" << body << "    </body>"
+       << "    <body>\n";
+}
+
+void html_generator::render_document_end(std::ostream &os) {
+    os << "    </body>"
        << "</html>";
 }
 
-void html_generator::render_table_cell(std::ostream &os,
-                                       const std::string &cell_body) {
-    os << "<td>" << cell_body << "</td>";
+void html_generator::render_table_cell_begin(std::ostream &os) {
+    os << "<td>";
 }
 
-void html_generator::render_table_cell_left_aligned(
-    std::ostream &os, const std::string &cell_body) {
-    os << "<td class=\"qa_la\">" << cell_body << "</td>";
+void html_generator::render_table_cell_left_aligned_begin(std::ostream &os) {
+    os << "<td class=\"qa_la\">";
 }
 
-void html_generator::render_table_cell_right_aligned(
-    std::ostream &os, const std::string &cell_body) {
-    os << "<td class=\"qa_ra\">" << cell_body << "</td>";
+void html_generator::render_table_cell_right_aligned_begin(std::ostream &os) {
+    os << "<td class=\"qa_ra\">";
 }
 
-void html_generator::render_table_cell_center_aligned(
-    std::ostream &os, const std::string &cell_body) {
-    os << "<td class=\"qa_ca\">" << cell_body << "</td>";
+void html_generator::render_table_cell_center_aligned_begin(
+    std::ostream &os) {
+    os << "<td class=\"qa_ca\">";
 }
 
-void html_generator::render_table_row(std::ostream &os,
-                                      const std::string &cells) {
-    os << "<tr>" << cells << "</tr>";
+void html_generator::render_table_cell_end(std::ostream &os) {
+    os << "</td>";
 }
 
-void html_generator::render_table(std::ostream &os, const std::string &rows) {
-    os << "<table>" << rows << "</table>";
+void html_generator::render_table_row_begin(std::ostream &os) {
+    os << "<tr>";
 }
+
+void html_generator::render_table_row_end(std::ostream &os) { os << "</tr>"; }
+
+void html_generator::render_table_begin(std::ostream &os) { os << "<table>"; }
+
+void html_generator::render_table_end(std::ostream &os) { os << "</table>"; }
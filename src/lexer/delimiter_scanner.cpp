@@ -0,0 +1,207 @@
+#include "qac/lexer/delimiter_scanner.h"
+
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define QAC_SCANNER_X86
+#include <immintrin.h>
+#endif
+
+using namespace qac;
+using namespace std;
+
+namespace {
+
+inline bool is_markup_byte(char c) {
+    return c == '*' || c == '_' || c == '`' || c == '\\' || c == '|' ||
+           c == '#';
+}
+
+void scan_block_scalar(const char *block, block_masks &masks) {
+    masks = block_masks();
+    for (size_t i = 0; i < delimiter_scanner::BLOCK_SIZE; ++i) {
+        uint64_t bit = uint64_t(1) << i;
+        char c = block[i];
+        if (c == '\n') {
+            masks.newline |= bit;
+        } else if (c == ' ') {
+            masks.space |= bit;
+        } else if (is_markup_byte(c)) {
+            masks.markup |= bit;
+        }
+    }
+}
+
+#ifdef QAC_SCANNER_X86
+
+void scan_block_sse2(const char *block, block_masks &masks) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i underscore = _mm_set1_epi8('_');
+    const __m128i backtick = _mm_set1_epi8('`');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i pipe = _mm_set1_epi8('|');
+    const __m128i hash = _mm_set1_epi8('#');
+
+    masks = block_masks();
+    for (int i = 0; i < 4; ++i) {
+        __m128i bytes = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(block + 16 * i));
+
+        __m128i markup = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, star),
+                         _mm_cmpeq_epi8(bytes, underscore)),
+            _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, backtick),
+                             _mm_cmpeq_epi8(bytes, backslash)),
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, pipe),
+                             _mm_cmpeq_epi8(bytes, hash))));
+
+        int shift = 16 * i;
+        masks.newline |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(
+                             _mm_cmpeq_epi8(bytes, newline))))
+                         << shift;
+        masks.space |= uint64_t(static_cast<uint16_t>(
+                           _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space))))
+                       << shift;
+        masks.markup |=
+            uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(markup)))
+            << shift;
+    }
+}
+
+__attribute__((target("avx2"))) void scan_block_avx2(const char *block,
+                                                     block_masks &masks) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i underscore = _mm256_set1_epi8('_');
+    const __m256i backtick = _mm256_set1_epi8('`');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i pipe = _mm256_set1_epi8('|');
+    const __m256i hash = _mm256_set1_epi8('#');
+
+    masks = block_masks();
+    for (int i = 0; i < 2; ++i) {
+        __m256i bytes = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(block + 32 * i));
+
+        __m256i markup = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, star),
+                            _mm256_cmpeq_epi8(bytes, underscore)),
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(bytes, backtick),
+                                _mm256_cmpeq_epi8(bytes, backslash)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(bytes, pipe),
+                                _mm256_cmpeq_epi8(bytes, hash))));
+
+        int shift = 32 * i;
+        masks.newline |= uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(
+                             _mm256_cmpeq_epi8(bytes, newline))))
+                         << shift;
+        masks.space |= uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(
+                           _mm256_cmpeq_epi8(bytes, space))))
+                       << shift;
+        masks.markup |=
+            uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(markup)))
+            << shift;
+    }
+}
+
+#endif
+
+struct implementation {
+    scan_block_fn scan_block;
+    const char *name;
+};
+
+implementation select_implementation() {
+#ifdef QAC_SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {scan_block_avx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return {scan_block_sse2, "sse2"};
+    }
+#endif
+    return {scan_block_scalar, "scalar"};
+}
+
+const implementation &best() {
+    static const implementation impl = select_implementation();
+    return impl;
+}
+
+inline unsigned trailing_zeros(uint64_t bits) {
+#ifdef __GNUC__
+    return static_cast<unsigned>(__builtin_ctzll(bits));
+#else
+    unsigned count = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+}
+
+delimiter_scanner::delimiter_scanner(const char *data, size_t size)
+    : data_(data), size_(size), scan_block_(best().scan_block) {}
+
+const char *delimiter_scanner::implementation_name() { return best().name; }
+
+scan_block_fn delimiter_scanner::scalar_implementation() {
+    return scan_block_scalar;
+}
+
+scan_block_fn delimiter_scanner::best_implementation() {
+    return best().scan_block;
+}
+
+bool delimiter_scanner::is_markup(const char *pos) {
+    size_t offset = static_cast<size_t>(pos - data_);
+    load_block(offset / BLOCK_SIZE);
+    return (masks_.markup >> (offset % BLOCK_SIZE)) & 1;
+}
+
+const char *delimiter_scanner::find(const char *from, const char *to,
+                                    uint64_t block_masks::*mask) {
+    size_t offset = static_cast<size_t>(from - data_);
+    size_t limit = static_cast<size_t>(to - data_);
+
+    while (offset < limit) {
+        size_t block = offset / BLOCK_SIZE;
+        load_block(block);
+
+        uint64_t bits = (masks_.*mask) >> (offset % BLOCK_SIZE);
+        if (bits) {
+            size_t found = offset + trailing_zeros(bits);
+            return found < limit ? data_ + found : to;
+        }
+
+        offset = (block + 1) * BLOCK_SIZE;
+    }
+
+    return to;
+}
+
+void delimiter_scanner::load_block(size_t block) {
+    if (block == block_) {
+        return;
+    }
+
+    size_t offset = block * BLOCK_SIZE;
+    if (offset + BLOCK_SIZE <= size_) {
+        scan_block_(data_ + offset, masks_);
+    } else {
+        // the last block is padded, zeros are no structural bytes
+        char padded[BLOCK_SIZE] = {};
+        memcpy(padded, data_ + offset, size_ - offset);
+        scan_block_(padded, masks_);
+    }
+
+    block_ = block;
+}
@@ -1,159 +1,794 @@
 #include "qac/lexer/lexer.h"
-#include <fstream>
+#include "qac/lexer/delimiter_scanner.h"
+#include "qac/lexer/mapped_file.h"
+#include "qac/lexer/token_cache.h"
+#include "qac/util/thread_pool.h"
+#include "qac/util/trace.h"
+#include <algorithm>
+#include <array>
+#include <future>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <utility>
 
-#include <boost/algorithm/string.hpp>
-
 using namespace qac;
 using namespace std;
 
-std::set<std::string> lexer::included_files_;
-
-bool lexer_state::matches_opening_token(string &word) {
-    string opening_token = get_opening_string_token();
-    if (word.length() >= opening_token.length() &&
-        boost::starts_with(word, opening_token)) {
-        boost::erase_head(word, static_cast<int>(opening_token.length()));
-        return true;
+namespace {
+
+constexpr string_view TOKEN_COMMENT = "#";
+constexpr string_view TOKEN_FILE = "FILE:";
+
+constexpr lexer_state LATEX_STATE = {
+    "\\(", "\\)", token_enum::LATEX_OPENING, token_enum::LATEX_CODE,
+    token_enum::LATEX_CLOSING};
+constexpr lexer_state CENTERED_LATEX_STATE = {
+    "\\[", "\\]", token_enum::LATEX_CENTERED_OPENING, token_enum::LATEX_CODE,
+    token_enum::LATEX_CENTERED_CLOSING};
+constexpr lexer_state BOLD_STATE = {"*", "*", token_enum::BOLD_OPENING,
+                                    token_enum::WORD,
+                                    token_enum::BOLD_CLOSING};
+constexpr lexer_state UNDERLINE_STATE = {"_", "_",
+                                         token_enum::UNDERLINE_OPENING,
+                                         token_enum::WORD,
+                                         token_enum::UNDERLINE_CLOSING};
+constexpr lexer_state CODE_STATE = {"`", "`", token_enum::CODE_OPENING,
+                                    token_enum::WORD,
+                                    token_enum::CODE_CLOSING};
+
+// the states as they are numbered in the cache
+constexpr array<const lexer_state *, 6> STATES = {
+    nullptr, &LATEX_STATE, &CENTERED_LATEX_STATE, &BOLD_STATE,
+    &UNDERLINE_STATE, &CODE_STATE};
+
+/*
+ * Cache entries
+ * =============
+ *
+ * An entry holds the tokens of a file as spans of its text, followed by its
+ * FILE: lines. Offsets and lines are stored as the difference to the token
+ * before, all numbers as varints of 7 bits per byte. Most tokens take five
+ * bytes, a third of what they take in memory.
+ *
+ * header   "qact" FORMAT lines state tokens includes
+ * token    type offset length line column
+ * include  position size filename
+ */
+constexpr string_view CACHE_MAGIC = "qact";
+constexpr uint64_t CACHE_FORMAT = 1;
+
+void write_number(string &entry, uint64_t number) {
+    while (number >= 0x80) {
+        entry += static_cast<char>(number | 0x80);
+        number >>= 7;
     }
+    entry += static_cast<char>(number);
+}
 
+bool read_number(string_view &entry, uint64_t &number) {
+    number = 0;
+    for (int shift = 0; shift < 64 && !entry.empty(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(entry.front());
+        entry.remove_prefix(1);
+        number |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
     return false;
 }
 
-pair<bool, string> lexer_state::matches_closing_token(string &word) {
-    string closing_token = get_closing_string_token();
+/*
+ * Word classification
+ * ===================
+ *
+ * Every word is classified by a single pass over its bytes through a
+ * deterministic automaton. Bytes are first mapped to a few byte classes, the
+ * transition table is indexed by (state, byte class). Both tables are built
+ * at compile time from the keyword list below.
+ *
+ * EXACT keywords have to match the whole word, OPENING keywords only have to
+ * prefix it (the rest of the word is lexed within the opened lexer_state) and
+ * PREFIX keywords accept whatever follows. Two patterns are added by hand:
+ * IMG(...) has to end with a closing parenthesis, and ordered list items are
+ * an optional run of digits followed by a dot.
+ */
+enum class word_class : uint8_t {
+    NONE,
+    QUESTION,
+    ANSWER,
+    CHAPTER,
+    SECTION,
+    SUBSECTION,
+    FILE,
+    UNORDERED_LIST_ITEM,
+    ORDERED_LIST_ITEM,
+    TABLE_CELL,
+    TABLE_CELL_LEFT_ALIGNED,
+    TABLE_CELL_RIGHT_ALIGNED,
+    TABLE_CELL_CENTER_ALIGNED,
+    TABLE_DIVIDER,
+    IMAGE,
+    LATEX_OPENING,
+    LATEX_CENTERED_OPENING,
+    BOLD_OPENING,
+    UNDERLINE_OPENING,
+    CODE_OPENING,
+};
 
-    if (word.length() < closing_token.length()) {
-        return make_pair<bool, string>(false, string(""));
+enum class match_kind : uint8_t { EXACT, OPENING, PREFIX };
+
+struct keyword {
+    string_view text;
+    word_class wclass;
+    match_kind kind;
+};
+
+constexpr keyword KEYWORDS[] = {
+    {"Q:", word_class::QUESTION, match_kind::EXACT},
+    {"A:", word_class::ANSWER, match_kind::EXACT},
+    {"CHA:", word_class::CHAPTER, match_kind::EXACT},
+    {"SEC:", word_class::SECTION, match_kind::EXACT},
+    {"SUB:", word_class::SUBSECTION, match_kind::EXACT},
+    {TOKEN_FILE, word_class::FILE, match_kind::EXACT},
+    {"-", word_class::UNORDERED_LIST_ITEM, match_kind::EXACT},
+    {"#.", word_class::ORDERED_LIST_ITEM, match_kind::EXACT},
+    {"|", word_class::TABLE_CELL, match_kind::EXACT},
+    {"|<", word_class::TABLE_CELL_LEFT_ALIGNED, match_kind::EXACT},
+    {"|>", word_class::TABLE_CELL_RIGHT_ALIGNED, match_kind::EXACT},
+    {"|-", word_class::TABLE_CELL_CENTER_ALIGNED, match_kind::EXACT},
+    {"---", word_class::TABLE_DIVIDER, match_kind::PREFIX},
+    {"IMG(", word_class::NONE, match_kind::EXACT},
+    {LATEX_STATE.opening, word_class::LATEX_OPENING, match_kind::OPENING},
+    {CENTERED_LATEX_STATE.opening, word_class::LATEX_CENTERED_OPENING,
+     match_kind::OPENING},
+    {BOLD_STATE.opening, word_class::BOLD_OPENING, match_kind::OPENING},
+    {UNDERLINE_STATE.opening, word_class::UNDERLINE_OPENING,
+     match_kind::OPENING},
+    {CODE_STATE.opening, word_class::CODE_OPENING, match_kind::OPENING},
+};
+
+constexpr size_t MAX_STATES = 64;
+constexpr size_t MAX_BYTE_CLASSES = 32;
+constexpr uint8_t DEAD_STATE = 0;
+constexpr uint8_t START_STATE = 1;
+
+struct word_dfa {
+    array<uint8_t, 256> byte_class{};
+    array<array<uint8_t, MAX_BYTE_CLASSES>, MAX_STATES> next{};
+    array<word_class, MAX_STATES> accepts{};
+    array<bool, MAX_STATES> opening{};
+    uint8_t nr_byte_classes = 1;  // class 0: bytes without a transition
+    uint8_t nr_states = 2;        // dead and start state
+
+    constexpr uint8_t add_byte_class(char c) {
+        uint8_t &bclass = byte_class[static_cast<uint8_t>(c)];
+        if (bclass == 0) {
+            bclass = nr_byte_classes++;
+        }
+        return bclass;
     }
 
-    if (word.length() >= closing_token.length() &&
-        boost::ends_with(word, closing_token)) {
-        boost::erase_tail(word, static_cast<int>(closing_token.length()));
-        return make_pair<bool, string>(true, string(""));
+    constexpr uint8_t add_transition(uint8_t state, char c) {
+        uint8_t &target = next[state][byte_class[static_cast<uint8_t>(c)]];
+        if (target == DEAD_STATE) {
+            target = nr_states++;
+        }
+        return target;
     }
 
-    if (ends_with_punctuation(word)) {
-        string tmp_word = word.substr(0, word.length() - 1);
-        if (tmp_word.length() >= closing_token.length() &&
-            boost::ends_with(tmp_word, closing_token)) {
-            string punctuation{word[word.length() - 1]};
-            boost::erase_tail(word,
-                              static_cast<int>(closing_token.length() + 1));
-            return make_pair<bool, string>(true, string(punctuation));
+    constexpr void loop_all(uint8_t state, uint8_t target) {
+        for (size_t bclass = 0; bclass < MAX_BYTE_CLASSES; ++bclass) {
+            next[state][bclass] = target;
+        }
+    }
+};
+
+constexpr word_dfa make_word_dfa() {
+    word_dfa dfa;
+
+    for (const keyword &kw : KEYWORDS) {
+        for (char c : kw.text) {
+            dfa.add_byte_class(c);
         }
     }
+    uint8_t digit_class = dfa.add_byte_class('0');
+    for (char c = '1'; c <= '9'; ++c) {
+        dfa.byte_class[static_cast<uint8_t>(c)] = digit_class;
+    }
+    uint8_t close_paren_class = dfa.add_byte_class(')');
+
+    uint8_t image_args = 0;
+    for (const keyword &kw : KEYWORDS) {
+        uint8_t state = START_STATE;
+        for (char c : kw.text) {
+            state = dfa.add_transition(state, c);
+        }
 
-    return make_pair<bool, string>(false, string(""));
+        dfa.accepts[state] = kw.wclass;
+        dfa.opening[state] = kw.kind == match_kind::OPENING;
+        if (kw.kind == match_kind::PREFIX) {
+            dfa.loop_all(state, state);
+        }
+        if (kw.text == "IMG(") {
+            image_args = state;
+        }
+    }
+
+    // IMG( followed by anything, as long as the word ends with ')'
+    uint8_t image_body = dfa.nr_states++;
+    uint8_t image_end = dfa.nr_states++;
+    for (uint8_t state : {image_args, image_body, image_end}) {
+        dfa.loop_all(state, image_body);
+        dfa.next[state][close_paren_class] = image_end;
+    }
+    dfa.accepts[image_end] = word_class::IMAGE;
+
+    // [0-9]*\.
+    uint8_t digits = dfa.nr_states++;
+    uint8_t dot = dfa.nr_states++;
+    dfa.next[START_STATE][digit_class] = digits;
+    dfa.next[digits][digit_class] = digits;
+    dfa.next[START_STATE][dfa.byte_class['.']] = dot;
+    dfa.next[digits][dfa.byte_class['.']] = dot;
+    dfa.accepts[dot] = word_class::ORDERED_LIST_ITEM;
+
+    return dfa;
+}
+
+constexpr word_dfa WORD_DFA = make_word_dfa();
+
+static_assert(WORD_DFA.nr_states <= MAX_STATES, "too many lexer states");
+static_assert(WORD_DFA.nr_byte_classes <= MAX_BYTE_CLASSES,
+              "too many byte classes");
+
+// For OPENING keywords the walk stops as soon as the delimiter is complete,
+// so `length` tells how many bytes of the word belong to it.
+struct classified_word {
+    word_class wclass;
+    size_t length;
 };
 
-bool lexer_state::ends_with_punctuation(const string &word) {
+classified_word classify(string_view word) {
+    uint8_t state = START_STATE;
+
+    for (size_t i = 0; i < word.size(); ++i) {
+        state = WORD_DFA.next[state][WORD_DFA.byte_class[static_cast<uint8_t>(
+            word[i])]];
+
+        if (state == DEAD_STATE) {
+            return {word_class::NONE, i};
+        }
+        if (WORD_DFA.opening[state]) {
+            return {WORD_DFA.accepts[state], i + 1};
+        }
+    }
+
+    return {WORD_DFA.accepts[state], word.size()};
+}
+
+const lexer_state *opened_state(word_class wclass) {
+    switch (wclass) {
+        case word_class::LATEX_OPENING:
+            return &LATEX_STATE;
+        case word_class::LATEX_CENTERED_OPENING:
+            return &CENTERED_LATEX_STATE;
+        case word_class::BOLD_OPENING:
+            return &BOLD_STATE;
+        case word_class::UNDERLINE_OPENING:
+            return &UNDERLINE_STATE;
+        case word_class::CODE_OPENING:
+            return &CODE_STATE;
+        default:
+            return nullptr;
+    }
+}
+
+bool is_table_cell(word_class wclass) {
+    return wclass == word_class::TABLE_CELL ||
+           wclass == word_class::TABLE_CELL_LEFT_ALIGNED ||
+           wclass == word_class::TABLE_CELL_RIGHT_ALIGNED ||
+           wclass == word_class::TABLE_CELL_CENTER_ALIGNED;
+}
+
+token_enum to_token_enum(word_class wclass) {
+    switch (wclass) {
+        case word_class::QUESTION:
+            return token_enum::QUESTION;
+        case word_class::ANSWER:
+            return token_enum::ANSWER;
+        case word_class::CHAPTER:
+            return token_enum::CHAPTER;
+        case word_class::SECTION:
+            return token_enum::SECTION;
+        case word_class::SUBSECTION:
+            return token_enum::SUBSECTION;
+        case word_class::UNORDERED_LIST_ITEM:
+            return token_enum::UNORDERED_LIST_ITEM;
+        case word_class::ORDERED_LIST_ITEM:
+            return token_enum::ORDERED_LIST_ITEM;
+        case word_class::TABLE_CELL:
+            return token_enum::TABLE_CELL;
+        case word_class::TABLE_CELL_LEFT_ALIGNED:
+            return token_enum::TABLE_CELL_LEFT_ALIGNED;
+        case word_class::TABLE_CELL_RIGHT_ALIGNED:
+            return token_enum::TABLE_CELL_RIGHT_ALIGNED;
+        case word_class::TABLE_CELL_CENTER_ALIGNED:
+            return token_enum::TABLE_CELL_CENTER_ALIGNED;
+        case word_class::TABLE_DIVIDER:
+            return token_enum::TABLE_DIVIDER;
+        case word_class::IMAGE:
+            return token_enum::IMAGE;
+        default:
+            return token_enum::WORD;
+    }
+}
+
+bool starts_with(string_view str, string_view prefix) {
+    return str.size() >= prefix.size() &&
+           str.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool ends_with(string_view str, string_view suffix) {
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool ends_with_punctuation(string_view word) {
     if (word.empty()) {
         return false;
     }
 
     char last_char = word[word.length() - 1];
-    auto check = boost::is_any_of(".,!?:;");
-    return check(last_char);
+    return string_view(".,!?:;").find(last_char) != string_view::npos;
 }
 
-class lexer_state_latex : public lexer_state {
-   public:
-    string get_opening_string_token() override { return "\\("; }
-    string get_closing_string_token() override { return "\\)"; }
-    token_enum get_opening_token() override {
-        return token_enum::LATEX_OPENING;
-    }
-    token_enum get_in_between_token() override {
-        return token_enum::LATEX_CODE;
+// Strips the closing delimiter (and a directly following punctuation mark,
+// which is returned) from the end of word.
+pair<bool, string_view> matches_closing_token(const lexer_state &state,
+                                              string_view &word) {
+    string_view closing_token = state.closing;
+
+    if (word.length() < closing_token.length()) {
+        return make_pair(false, string_view());
     }
-    token_enum get_closing_token() override {
-        return token_enum::LATEX_CLOSING;
+
+    if (ends_with(word, closing_token)) {
+        word.remove_suffix(closing_token.length());
+        return make_pair(true, string_view());
     }
-};
 
-class lexer_state_centered_latex : public lexer_state {
-   public:
-    string get_opening_string_token() override { return "\\["; }
-    string get_closing_string_token() override { return "\\]"; }
-    token_enum get_opening_token() override {
-        return token_enum::LATEX_CENTERED_OPENING;
+    if (ends_with_punctuation(word)) {
+        string_view tmp_word = word.substr(0, word.length() - 1);
+        if (ends_with(tmp_word, closing_token)) {
+            string_view punctuation = word.substr(word.length() - 1);
+            word.remove_suffix(closing_token.length() + 1);
+            return make_pair(true, punctuation);
+        }
     }
-    token_enum get_in_between_token() override {
-        return token_enum::LATEX_CODE;
+
+    return make_pair(false, string_view());
+}
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' ||
+           c == '\r';
+}
+
+string_view trim(string_view str) {
+    while (!str.empty() && is_space(str.front())) {
+        str.remove_prefix(1);
     }
-    token_enum get_closing_token() override {
-        return token_enum::LATEX_CENTERED_CLOSING;
+    while (!str.empty() && is_space(str.back())) {
+        str.remove_suffix(1);
     }
-};
+    return str;
+}
 
-class lexer_state_bold : public lexer_state {
-   public:
-    string get_opening_string_token() override { return "*"; }
-    string get_closing_string_token() override { return "*"; }
-    token_enum get_opening_token() override { return token_enum::BOLD_OPENING; }
-    token_enum get_in_between_token() override { return token_enum::WORD; }
-    token_enum get_closing_token() override { return token_enum::BOLD_CLOSING; }
-};
+// inputs are only split if every chunk gets at least this many bytes
+constexpr size_t MIN_CHUNK_SIZE = 1 << 16;
+
+// Blank lines and lines starting a question or heading usually have no
+// delimiter open, which makes them good places to start a chunk.
+bool is_chunk_boundary(string_view line) {
+    line = trim(line);
+    string_view first_word = line.substr(0, line.find(' '));
+    return line.empty() || first_word == "Q:" || first_word == "CHA:" ||
+           first_word == "SEC:" || first_word == "SUB:";
+}
 
-class lexer_state_underline : public lexer_state {
-   public:
-    string get_opening_string_token() override { return "_"; }
-    string get_closing_string_token() override { return "_"; }
-    token_enum get_opening_token() override {
-        return token_enum::UNDERLINE_OPENING;
+// start of the first chunk boundary line after pos, or text.size()
+size_t next_chunk_start(string_view text, size_t pos) {
+    while ((pos = text.find('\n', pos)) != string_view::npos) {
+        ++pos;
+        if (is_chunk_boundary(text.substr(pos, text.find('\n', pos) - pos))) {
+            return pos;
+        }
     }
-    token_enum get_in_between_token() override { return token_enum::WORD; }
-    token_enum get_closing_token() override {
-        return token_enum::UNDERLINE_CLOSING;
+    return text.size();
+}
+
+vector<string_view> split_chunks(string_view text, size_t count) {
+    vector<string_view> chunks;
+    size_t begin = 0;
+
+    for (size_t i = 1; i < count; ++i) {
+        size_t end =
+            next_chunk_start(text, max(begin, text.size() * i / count));
+        if (end == text.size()) {
+            break;
+        }
+        chunks.push_back(text.substr(begin, end - begin));
+        begin = end;
     }
-};
+    chunks.push_back(text.substr(begin));
 
-class lexer_state_code : public lexer_state {
-   public:
-    string get_opening_string_token() override { return "`"; }
-    string get_closing_string_token() override { return "`"; }
-    token_enum get_opening_token() override { return token_enum::CODE_OPENING; }
-    token_enum get_in_between_token() override { return token_enum::WORD; }
-    token_enum get_closing_token() override { return token_enum::CODE_CLOSING; }
-};
+    return chunks;
+}
+}
 
 bool token::is(token_enum token) const { return token_ == token; }
 
 token_enum token::get_token() const { return token_; }
 
-string token::get_value() const { return value_; }
-
 std::ostream &qac::operator<<(std::ostream &os, const token &token) {
-    os << token.token_ << "@" << token.line_ << "[" << token.value_ << "]";
+    os << token.token_ << "@" << token.line_ << "[" << token.get_value()
+       << "]";
     return os;
 }
 
-lexer::lexer() {
-    possible_states_.push_back(make_unique<lexer_state_latex>());
-    possible_states_.push_back(make_unique<lexer_state_centered_latex>());
-    possible_states_.push_back(make_unique<lexer_state_bold>());
-    possible_states_.push_back(make_unique<lexer_state_underline>());
-    possible_states_.push_back(make_unique<lexer_state_code>());
-}
+lexer::lexer() {}
+
+lexer::~lexer() {}
 
 vector<token> lexer::lex(std::istream &input) {
-    uint16_t line_nr = 0;
-    string line;
+    // tokens point into the lexed text, so keep a copy of the whole stream
+    buffers_.push_back(make_unique<string>(istreambuf_iterator<char>(input),
+                                           istreambuf_iterator<char>()));
+    const string &buffer = *buffers_.back();
+
+    return lex(buffer.data(), buffer.size());
+}
+
+vector<token> lexer::lex(const char *data, size_t size) {
+    lex_text(data, size);
 
-    while (getline(input, line)) {
-        lex_line(tokens_, line, ++line_nr);
+    if (!pending_includes_.empty()) {
+        splice_includes();
     }
 
     return tokens_;
 }
 
-void lexer::lex_line(vector<token> &tokens, const string &line, int line_nr) {
-    string trimmed_line = boost::trim_copy(line);
+vector<token> lexer::lex_file(const string &filename) {
+    if (files_.empty()) {
+        files_.push_back(filename);
+    }
+
+    string path = canonical_path(filename);
+    included_files_.insert(path);
+    include_lexers_[path];
+
+    mapped_files_.push_back(make_unique<mapped_file>(filename));
+    const mapped_file &input = *mapped_files_.back();
+
+    return lex(input.data(), input.size());
+}
+
+void lexer::lex_text(const char *data, size_t size) {
+    string key;
+    if (cache_) {
+        key = cache_->key(string_view(data, size));
+        if (load_cached(key, data, size)) {
+            return;
+        }
+    }
 
-    if (boost::starts_with(trimmed_line, TOKEN_COMMENT)) {
+    size_t first = tokens_.size();
+    unsigned threads = threads_ ? threads_ : thread::hardware_concurrency();
+    if (threads > 1 && size >= 2 * MIN_CHUNK_SIZE) {
+        lex_chunks(data, size);
+    } else {
+        lex_lines(data, size);
+    }
+
+    if (cache_) {
+        cache_->write(key, cache_entry(data, first));
+    }
+}
+
+// Appends the tokens of the cached text, false if the entry is missing or
+// can't be read.
+bool lexer::load_cached(const string &key, const char *data, size_t size) {
+    unique_ptr<mapped_file> file = cache_->read(key);
+    if (!file) {
+        return false;
+    }
+
+    string_view entry = file->text();
+    uint64_t format, lines, state, token_count, include_count;
+    if (entry.substr(0, CACHE_MAGIC.size()) != CACHE_MAGIC) {
+        return false;
+    }
+    entry.remove_prefix(CACHE_MAGIC.size());
+    if (!read_number(entry, format) || format != CACHE_FORMAT ||
+        !read_number(entry, lines) || !read_number(entry, state) ||
+        state >= STATES.size() || !read_number(entry, token_count) ||
+        !read_number(entry, include_count) || token_count > entry.size()) {
+        return false;
+    }
+
+    // the tokens are dropped again if the entry turns out to be broken
+    size_t first = tokens_.size();
+    auto broken = [&] {
+        tokens_.erase(tokens_.begin() + first, tokens_.end());
+        return false;
+    };
+    tokens_.reserve(first + token_count);
+    uint64_t offset = 0, line = 0;
+    for (uint64_t i = 0; i < token_count; ++i) {
+        uint64_t delta, length, line_delta, column;
+        if (entry.empty() ||
+            static_cast<uint8_t>(entry.front()) >
+                static_cast<uint8_t>(token_enum::IMAGE)) {
+            return broken();
+        }
+        auto type = static_cast<token_enum>(entry.front());
+        entry.remove_prefix(1);
+        if (!read_number(entry, delta) || !read_number(entry, length) ||
+            !read_number(entry, line_delta) || !read_number(entry, column) ||
+            delta > size - offset || length > size - offset - delta) {
+            return broken();
+        }
+        offset += delta;
+        line += line_delta;
+        tokens_.push_back(token(type, string_view(data + offset, length),
+                                static_cast<uint32_t>(line),
+                                static_cast<uint32_t>(column), file_id_));
+    }
+
+    vector<pending_include> includes;
+    for (uint64_t i = 0; i < include_count; ++i) {
+        uint64_t position, length;
+        if (!read_number(entry, position) || position > token_count ||
+            !read_number(entry, length) || length > entry.size()) {
+            return broken();
+        }
+        string filename(entry.substr(0, length));
+        entry.remove_prefix(length);
+        string path = canonical_path(filename);
+        includes.push_back(
+            {first + position, std::move(filename), std::move(path)});
+    }
+
+    QAC_TRACE(LEXER, RULE) << "read " << token_count << " tokens from cache";
+
+    move(includes.begin(), includes.end(),
+         back_inserter(pending_includes_));
+    line_count_ = static_cast<uint32_t>(lines);
+    cur_lexer_state_ = STATES[state];
+    return true;
+}
+
+// the tokens from first on, with the includes lexed with them
+string lexer::cache_entry(const char *data, size_t first) const {
+    vector<const pending_include *> includes;
+    for (const pending_include &include : pending_includes_) {
+        if (include.position >= first) {
+            includes.push_back(&include);
+        }
+    }
+
+    string entry(CACHE_MAGIC);
+    write_number(entry, CACHE_FORMAT);
+    write_number(entry, line_count_);
+    write_number(entry, find(STATES.begin(), STATES.end(), cur_lexer_state_) -
+                            STATES.begin());
+    write_number(entry, tokens_.size() - first);
+    write_number(entry, includes.size());
+
+    entry.reserve(entry.size() + (tokens_.size() - first) * 6);
+    size_t offset = 0;
+    uint32_t line = 0;
+    for (size_t i = first; i < tokens_.size(); ++i) {
+        const token &t = tokens_[i];
+        size_t token_offset = t.get_value().data() - data;
+        entry += static_cast<char>(t.get_token());
+        write_number(entry, token_offset - offset);
+        write_number(entry, t.get_value().size());
+        write_number(entry, t.line() - line);
+        write_number(entry, t.column());
+        offset = token_offset;
+        line = t.line();
+    }
+
+    for (const pending_include *include : includes) {
+        write_number(entry, include->position - first);
+        write_number(entry, include->filename.size());
+        entry += include->filename;
+    }
+
+    return entry;
+}
+
+void lexer::lex_lines(const char *data, size_t size) {
+    uint32_t line_nr = 0;
+    delimiter_scanner scanner(data, size);
+    const char *line_begin = data;
+    const char *end = data + size;
+
+    // same line semantics as std::getline: a trailing newline does not start
+    // another (empty) line
+    while (line_begin != end) {
+        const char *line_end = scanner.find_newline(line_begin, end);
+        lex_line(tokens_, string_view(line_begin, line_end - line_begin),
+                 ++line_nr, scanner);
+
+        if (line_end == end) {
+            break;
+        }
+        line_begin = line_end + 1;
+    }
+
+    line_count_ = line_nr;
+}
+
+void lexer::lex_chunks(const char *data, size_t size) {
+    unsigned threads = threads_ ? threads_ : thread::hardware_concurrency();
+    vector<string_view> chunks = split_chunks(
+        string_view(data, size), min<size_t>(threads, size / MIN_CHUNK_SIZE));
+
+    auto lex_chunk = [](string_view chunk, const lexer_state *state) {
+        auto chunk_lexer = make_unique<lexer>();
+        chunk_lexer->cur_lexer_state_ = state;
+        chunk_lexer->lex_lines(chunk.data(), chunk.size());
+        return chunk_lexer;
+    };
+
+    QAC_TRACE(LEXER, RULE) << "lexing " << size << " bytes in "
+                           << chunks.size() << " chunks";
+
+    thread_pool pool(threads);
+    vector<future<unique_ptr<lexer>>> results;
+    for (string_view chunk : chunks) {
+        results.push_back(
+            pool.submit([=] { return lex_chunk(chunk, nullptr); }));
+    }
+
+    uint32_t line_offset = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        unique_ptr<lexer> chunk_lexer = results[i].get();
+
+        // the previous chunk left a delimiter open, so the chunk has to be
+        // lexed again from the right state
+        if (cur_lexer_state_) {
+            QAC_TRACE(LEXER, RULE) << "lexing chunk " << i << " again";
+            chunk_lexer = lex_chunk(chunks[i], cur_lexer_state_);
+        }
+
+        append_chunk(*chunk_lexer, line_offset);
+        cur_lexer_state_ = chunk_lexer->cur_lexer_state_;
+        line_offset += chunk_lexer->line_count_;
+    }
+
+    line_count_ = line_offset;
+}
+
+void lexer::append_chunk(const lexer &chunk, uint32_t line_offset) {
+    for (const pending_include &include : chunk.pending_includes_) {
+        pending_includes_.push_back({tokens_.size() + include.position,
+                                     include.filename, include.path});
+    }
+
+    tokens_.reserve(tokens_.size() + chunk.tokens_.size());
+    for (const token &t : chunk.tokens_) {
+        tokens_.push_back(token(t.get_token(), t.get_value(),
+                                t.line() + line_offset, t.column()));
+    }
+}
+
+void lexer::queue_includes(const vector<pending_include> &includes) {
+    lock_guard<mutex> lock(includes_mutex_);
+
+    for (const pending_include &include : includes) {
+        const string &path = include.path;
+        if (include_lexers_.count(path)) {
+            continue;
+        }
+
+        QAC_TRACE(LEXER, RULE) << "including " << path;
+        include_lexers_[path] = include_pool_->submit([this, path] {
+            auto file_lexer = make_unique<lexer>();
+            auto input = make_unique<mapped_file>(path);
+            file_lexer->cache_ = cache_;
+            file_lexer->lex_text(input->data(), input->size());
+            file_lexer->mapped_files_.push_back(std::move(input));
+
+            queue_includes(file_lexer->pending_includes_);
+            return file_lexer;
+        });
+    }
+}
+
+void lexer::splice_includes() {
+    vector<token_range> ranges;
+    vector<unique_ptr<lexer>> included;
+    if (files_.empty()) {
+        files_.emplace_back();
+    }
+    {
+        thread_pool pool(threads_);
+        include_pool_ = &pool;
+        queue_includes(pending_includes_);
+        collect_ranges(*this, 0, ranges, included);
+        include_pool_ = nullptr;
+    }
+
+    size_t size = 0;
+    for (const token_range &range : ranges) {
+        size += range.last - range.first;
+    }
+
+    vector<token> tokens;
+    tokens.reserve(size);
+    for (const token_range &range : ranges) {
+        if (!range.file) {
+            tokens.insert(tokens.end(), range.first, range.last);
+            continue;
+        }
+
+        // included tokens were lexed without knowing their file id
+        for (const token *t = range.first; t != range.last; ++t) {
+            tokens.push_back(token(t->get_token(), t->get_value(), t->line(),
+                                   t->column(), range.file));
+        }
+    }
+    tokens_ = std::move(tokens);
+    pending_includes_.clear();
+
+    // keep the included sources alive as long as this lexer's tokens
+    for (unique_ptr<lexer> &file_lexer : included) {
+        move(file_lexer->mapped_files_.begin(),
+             file_lexer->mapped_files_.end(), back_inserter(mapped_files_));
+    }
+}
+
+// Splits file's tokens at its includes, in document order. Files are lexed
+// on the pool, this only waits for them.
+void lexer::collect_ranges(const lexer &file, uint16_t file_id,
+                           vector<token_range> &ranges,
+                           vector<unique_ptr<lexer>> &included) {
+    const token *tokens = file.tokens_.data();
+    size_t begin = 0;
+
+    for (const pending_include &include : file.pending_includes_) {
+        ranges.push_back({tokens + begin, tokens + include.position, file_id});
+        begin = include.position;
+
+        if (!included_files_.insert(include.path).second) {
+            continue;
+        }
+
+        future<unique_ptr<lexer>> file_lexer;
+        {
+            lock_guard<mutex> lock(includes_mutex_);
+            file_lexer = std::move(include_lexers_.at(include.path));
+        }
+        included.push_back(file_lexer.get());
+        files_.push_back(include.filename);
+        uint16_t included_id = static_cast<uint16_t>(files_.size() - 1);
+        collect_ranges(*included.back(), included_id, ranges, included);
+    }
+
+    ranges.push_back({tokens + begin, tokens + file.tokens_.size(), file_id});
+}
+
+void lexer::lex_line(vector<token> &tokens, string_view line,
+                     uint32_t line_nr, delimiter_scanner &scanner) {
+    string_view trimmed_line = trim(line);
+
+    if (starts_with(trimmed_line, TOKEN_COMMENT)) {
         // check if it's an list item, and not a comment
         string::size_type min_size = TOKEN_COMMENT.size() + 1;
         if (!(trimmed_line.size() >= min_size &&
@@ -163,29 +798,29 @@ void lexer::lex_line(vector<token> &tokens, const string &line, int line_nr) {
     }
 
     if (trimmed_line.empty()) {
-        tokens.push_back(token(token_enum::EMPTY_LINE, "", line_nr));
+        push_token(tokens, token_enum::EMPTY_LINE, line.substr(line.size()),
+                   line, line_nr);
         return;
     }
 
-    vector<string> words;
-    boost::split(words, trimmed_line, boost::is_any_of(" "));
-
-    auto check_for_closing_token = [&](string &word) {
-        auto closes = cur_lexer_state_->matches_closing_token(word);
+    auto check_for_closing_token = [&](string_view &word) {
+        auto closes = matches_closing_token(*cur_lexer_state_, word);
 
         if (!word.empty()) {
-            tokens.push_back(
-                token(cur_lexer_state_->get_in_between_token(), word, line_nr));
+            push_token(tokens, cur_lexer_state_->in_between_token, word, line,
+                       line_nr);
         }
 
         if (get<bool>(closes)) {
-            tokens.push_back(token(cur_lexer_state_->get_closing_token(),
-                                   cur_lexer_state_->get_closing_string_token(),
-                                   line_nr));
+            // the closing delimiter directly follows the remaining word
+            string_view closing(word.data() + word.size(),
+                                cur_lexer_state_->closing.size());
+            push_token(tokens, cur_lexer_state_->closing_token, closing, line,
+                       line_nr);
 
-            auto appended = get<string>(closes);
+            auto appended = get<string_view>(closes);
             if (!appended.empty()) {
-                tokens.push_back(token(token_enum::WORD, appended, line_nr));
+                push_token(tokens, token_enum::WORD, appended, line, line_nr);
             }
 
             cur_lexer_state_ = nullptr;
@@ -195,119 +830,57 @@ void lexer::lex_line(vector<token> &tokens, const string &line, int line_nr) {
     bool first_word = true;
     bool has_table = false;
 
-    for (auto word : words) {
-        bool was_q_or_a = false;
-
-        if (!cur_lexer_state_) {
-            bool lexed_word = false;
-            for (auto &possible_state : possible_states_) {
-                if (possible_state->matches_opening_token(word)) {
-                    cur_lexer_state_ = possible_state.get();
-                    lexed_word = true;
+    // words are separated by single spaces, consecutive spaces yield empty
+    // words
+    const char *word_begin = trimmed_line.data();
+    const char *line_end = word_begin + trimmed_line.size();
+    bool more_words = true;
 
-                    tokens.push_back(token(
-                        cur_lexer_state_->get_opening_token(),
-                        cur_lexer_state_->get_opening_string_token(), line_nr));
-                    check_for_closing_token(word);
+    while (more_words) {
+        const char *word_end = scanner.find_space(word_begin, line_end);
+        string_view word(word_begin, word_end - word_begin);
+        more_words = word_end != line_end;
+        word_begin = word_end + 1;
 
-                    break;
-                }
-            }
+        bool was_q_or_a = false;
 
-            if (lexed_word) {
+        if (!cur_lexer_state_ && !first_word && !has_table &&
+            (word.empty() ||
+             (word[0] != 'I' && !scanner.is_markup(word.data())))) {
+            // only delimiters and IMG( are recognized here, and they all
+            // start with markup or an I
+            push_token(tokens, token_enum::WORD, word, line, line_nr);
+        } else if (!cur_lexer_state_) {
+            classified_word classified = classify(word);
+            word_class wclass = classified.wclass;
+
+            if (const lexer_state *state = opened_state(wclass)) {
+                cur_lexer_state_ = state;
+                push_token(tokens, state->opening_token,
+                           word.substr(0, classified.length), line, line_nr);
+                word.remove_prefix(classified.length);
+                check_for_closing_token(word);
                 continue;
             }
 
             if (first_word) {
-                if (word == TOKEN_QUESTION) {
-                    tokens.push_back(
-                        token(token_enum::QUESTION, word, line_nr));
-                    was_q_or_a = true;
-                } else if (word == TOKEN_ANSWER) {
-                    tokens.push_back(token(token_enum::ANSWER, word, line_nr));
-                    was_q_or_a = true;
-                } else if (word == TOKEN_CHAPTER) {
-                    tokens.push_back(token(token_enum::CHAPTER, word, line_nr));
-                } else if (word == TOKEN_SECTION) {
-                    tokens.push_back(token(token_enum::SECTION, word, line_nr));
-                } else if (word == TOKEN_SUBSECTION) {
-                    tokens.push_back(
-                        token(token_enum::SUBSECTION, word, line_nr));
-                } else if (word == TOKEN_FILE) {
-                    lex_file(line, line_nr);
+                if (wclass == word_class::FILE) {
+                    string filename(line.substr(TOKEN_FILE.length() + 1));
+                    string path = canonical_path(filename);
+                    pending_includes_.push_back(
+                        {tokens.size(), std::move(filename), std::move(path)});
                     return;
-                } else if (word == TOKEN_UNORDERED_LIST_ITEM) {
-                    tokens.push_back(
-                        token(token_enum::UNORDERED_LIST_ITEM, word, line_nr));
-                } else if (word == TOKEN_ORDERED_LIST_ITEM) {
-                    tokens.push_back(
-                        token(token_enum::ORDERED_LIST_ITEM, word, line_nr));
-                } else if (word == TOKEN_TABLE_CELL) {
-                    has_table = true;
-                    tokens.push_back(
-                        token(token_enum::TABLE_CELL, word, line_nr));
-                } else if (word == TOKEN_TABLE_CELL_LEFT_ALIGNED) {
-                    has_table = true;
-                    tokens.push_back(token(token_enum::TABLE_CELL_LEFT_ALIGNED,
-                                           word, line_nr));
-                } else if (word == TOKEN_TABLE_CELL_RIGHT_ALIGNED) {
-                    has_table = true;
-                    tokens.push_back(token(token_enum::TABLE_CELL_RIGHT_ALIGNED,
-                                           word, line_nr));
-                } else if (word == TOKEN_TABLE_CELL_CENTER_ALIGNED) {
-                    has_table = true;
-                    tokens.push_back(token(
-                        token_enum::TABLE_CELL_CENTER_ALIGNED, word, line_nr));
-                } else if (word.size() >= 3 &&
-                           boost::starts_with(word, "---")) {
-                    tokens.push_back(
-                        token(token_enum::TABLE_DIVIDER, word, line_nr));
-                } else if (boost::ends_with(word, ".") &&
-                           all_of(word.begin(), word.end() - 1, ::isdigit)) {
-                    tokens.push_back(
-                        token(token_enum::ORDERED_LIST_ITEM, word, line_nr));
-                } else if (boost::starts_with(word, "IMG(") &&
-                           boost::ends_with(word, ")")) {
-                    tokens.push_back(token(token_enum::IMAGE, word, line_nr));
-                } else {
-                    tokens.push_back(token(token_enum::WORD, word, line_nr));
-                }
-            } else {
-                if (has_table) {
-                    if (word == TOKEN_TABLE_CELL) {
-                        has_table = true;
-                        tokens.push_back(
-                            token(token_enum::TABLE_CELL, word, line_nr));
-                    } else if (word == TOKEN_TABLE_CELL_LEFT_ALIGNED) {
-                        has_table = true;
-                        tokens.push_back(
-                            token(token_enum::TABLE_CELL_LEFT_ALIGNED, word,
-                                  line_nr));
-                    } else if (word == TOKEN_TABLE_CELL_RIGHT_ALIGNED) {
-                        has_table = true;
-                        tokens.push_back(
-                            token(token_enum::TABLE_CELL_RIGHT_ALIGNED, word,
-                                  line_nr));
-                    } else if (word == TOKEN_TABLE_CELL_CENTER_ALIGNED) {
-                        has_table = true;
-                        tokens.push_back(
-                            token(token_enum::TABLE_CELL_CENTER_ALIGNED, word,
-                                  line_nr));
-                    } else if (boost::starts_with(word, "IMG(") &&
-                               boost::ends_with(word, ")")) {
-                        tokens.push_back(
-                            token(token_enum::IMAGE, word, line_nr));
-                    } else {
-                        tokens.push_back(
-                            token(token_enum::WORD, word, line_nr));
-                    }
-                } else if (boost::starts_with(word, "IMG(") &&
-                           boost::ends_with(word, ")")) {
-                    tokens.push_back(token(token_enum::IMAGE, word, line_nr));
-                } else {
-                    tokens.push_back(token(token_enum::WORD, word, line_nr));
                 }
+
+                was_q_or_a = wclass == word_class::QUESTION ||
+                             wclass == word_class::ANSWER;
+                has_table = has_table || is_table_cell(wclass);
+            } else if (!(has_table && is_table_cell(wclass)) &&
+                       wclass != word_class::IMAGE) {
+                wclass = word_class::NONE;
             }
+
+            push_token(tokens, to_token_enum(wclass), word, line, line_nr);
         } else {
             check_for_closing_token(word);
         }
@@ -317,23 +890,16 @@ void lexer::lex_line(vector<token> &tokens, const string &line, int line_nr) {
         }
     }
 
-    tokens.push_back(token(token_enum::NEW_LINE, "", line_nr));
+    push_token(tokens, token_enum::NEW_LINE, line.substr(line.size()), line,
+               line_nr);
 }
 
-void lexer::lex_file(const std::string &line, uint16_t line_nr) {
-    string filename = line.substr(TOKEN_FILE.length() + 1);
-    if (!include_file(filename)) {
-        return;
-    }
-
-    std::ifstream input(filename);
-    if (!input.is_open()) {
-        throw runtime_error("Couldn't open '" + filename + "'");
-    }
-
-    lexer lexer;
-    vector<token> tokens = lexer.lex(input);
-    copy(tokens.begin(), tokens.end(), back_inserter(tokens_));
+void lexer::push_token(vector<token> &tokens, token_enum tenum,
+                       string_view value, string_view line,
+                       uint32_t line_nr) {
+    uint32_t column = static_cast<uint32_t>(value.data() - line.data()) + 1;
+    tokens.push_back(token(tenum, value, line_nr, column, file_id_));
+    QAC_TRACE(LEXER, TOKEN) << tokens.back();
 }
 
 bool lexer::next_char_equals(const string &line, const size_t &cur_pos,
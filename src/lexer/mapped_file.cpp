@@ -0,0 +1,86 @@
+#include "qac/lexer/mapped_file.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define QAC_NO_MMAP
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace qac;
+using namespace std;
+
+#ifndef QAC_NO_MMAP
+
+mapped_file::mapped_file(const string &filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Couldn't open '" + filename + "'");
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw runtime_error("Couldn't open '" + filename + "'");
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            throw runtime_error("Couldn't map '" + filename + "'");
+        }
+        ::madvise(addr, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(addr);
+        mapped_ = true;
+    }
+
+    ::close(fd);
+}
+
+mapped_file::~mapped_file() {
+    if (mapped_) {
+        ::munmap(const_cast<char *>(data_), size_);
+    }
+}
+
+#else
+
+mapped_file::mapped_file(const string &filename) {
+    ifstream input(filename, ios::binary);
+    if (!input.is_open()) {
+        throw runtime_error("Couldn't open '" + filename + "'");
+    }
+
+    buffer_.assign(istreambuf_iterator<char>(input),
+                   istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+mapped_file::~mapped_file() {}
+
+#endif
+
+string qac::canonical_path(const string &filename) {
+#if defined(_WIN32)
+    char *resolved = _fullpath(nullptr, filename.c_str(), 0);
+#else
+    char *resolved = ::realpath(filename.c_str(), nullptr);
+#endif
+    if (!resolved) {
+        return filename;
+    }
+
+    string path(resolved);
+    free(resolved);
+    return path;
+}
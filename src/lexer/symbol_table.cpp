@@ -0,0 +1,78 @@
+#include "qac/lexer/symbol_table.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace qac;
+using namespace std;
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 1 << 16;
+
+// rough size of an unordered_map node and its bucket
+constexpr size_t HASH_ENTRY_SIZE =
+    sizeof(pair<string_view, uint32_t>) + 2 * sizeof(void *);
+}
+
+uint32_t symbol_table::intern(string_view text) {
+    auto it = ids_.find(text);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+
+    uint32_t symbol = static_cast<uint32_t>(symbols_.size());
+    string_view stored = store(text);
+    symbols_.push_back(stored);
+    ids_.emplace(stored, symbol);
+    return symbol;
+}
+
+size_t symbol_table::memory_usage() const {
+    return text_bytes_ + symbols_.capacity() * sizeof(string_view) +
+           ids_.size() * HASH_ENTRY_SIZE;
+}
+
+// copies text to a block, blocks never move so the views stay valid
+string_view symbol_table::store(string_view text) {
+    if (blocks_.empty() || block_used_ + text.size() > block_size_) {
+        block_size_ = max(BLOCK_SIZE, text.size());
+        blocks_.push_back(make_unique<char[]>(block_size_));
+        block_used_ = 0;
+        text_bytes_ += block_size_;
+    }
+
+    char *data = blocks_.back().get() + block_used_;
+    memcpy(data, text.data(), text.size());
+    block_used_ += text.size();
+
+    return string_view(data, text.size());
+}
+
+interned_tokens::interned_tokens(const vector<token> &tokens) {
+    tokens_.reserve(tokens.size());
+    for (const token &t : tokens) {
+        tokens_.push_back({symbols_.intern(t.get_value()), t.line(),
+                           t.file(), t.get_token()});
+    }
+}
+
+size_t interned_tokens::memory_usage() const {
+    return tokens_.capacity() * sizeof(compact_token) +
+           symbols_.memory_usage();
+}
+
+const token &interned_token_source::peek() {
+    peeked_ = next_ < tokens_.size()
+                  ? tokens_[next_]
+                  : token(token_enum::END_OF_FILE, "", 0);
+    return peeked_;
+}
+
+token interned_token_source::next() {
+    token token = peek();
+    if (next_ < tokens_.size()) {
+        ++next_;
+    }
+    return token;
+}
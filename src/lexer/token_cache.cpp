@@ -0,0 +1,152 @@
+#include "qac/lexer/token_cache.h"
+#include "qac/lexer/mapped_file.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+#include "qac_config.h"
+
+using namespace qac;
+using namespace std;
+
+namespace {
+
+uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+uint64_t fmix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// MurmurHash3_x64_128. SHA-1 would be slower than lexing the text, and
+// the key only has to tell apart contents that changed, not forged ones.
+void murmur3(string_view text, uint64_t seed, uint64_t &h1, uint64_t &h2) {
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    const char *data = text.data();
+    size_t blocks = text.size() / 16;
+    h1 = seed;
+    h2 = seed;
+
+    for (size_t i = 0; i < blocks; ++i) {
+        uint64_t k1, k2;
+        memcpy(&k1, data + i * 16, 8);
+        memcpy(&k2, data + i * 16 + 8, 8);
+
+        k1 *= c1;
+        k1 = rotl(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+        h1 = rotl(h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2;
+        k2 = rotl(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+        h2 = rotl(h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const unsigned char *tail =
+        reinterpret_cast<const unsigned char *>(data + blocks * 16);
+    size_t rest = text.size() & 15;
+    uint64_t k1 = 0, k2 = 0;
+    for (size_t i = rest; i > 8; --i) {
+        k2 ^= uint64_t(tail[i - 1]) << ((i - 9) * 8);
+    }
+    for (size_t i = min<size_t>(rest, 8); i > 0; --i) {
+        k1 ^= uint64_t(tail[i - 1]) << ((i - 1) * 8);
+    }
+    if (rest > 8) {
+        k2 *= c2;
+        k2 = rotl(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+    }
+    if (rest) {
+        k1 *= c1;
+        k1 = rotl(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+    }
+
+    h1 ^= text.size();
+    h2 ^= text.size();
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix(h1);
+    h2 = fmix(h2);
+    h1 += h2;
+    h2 += h1;
+}
+}
+
+token_cache::token_cache(const string &directory) : directory_(directory) {
+    error_code error;
+    filesystem::create_directories(directory_, error);
+    if (!filesystem::is_directory(directory_)) {
+        throw runtime_error("Couldn't create cache directory '" + directory_ +
+                            "'");
+    }
+}
+
+string token_cache::key(string_view text) const {
+    uint64_t seed, unused;
+    murmur3(QAC_VERSION, 0, seed, unused);
+
+    uint64_t h1, h2;
+    murmur3(text, seed, h1, h2);
+
+    ostringstream oss;
+    oss << hex << setfill('0') << setw(16) << h1 << setw(16) << h2 << "-"
+        << dec << text.size();
+    return oss.str();
+}
+
+unique_ptr<mapped_file> token_cache::read(const string &key) const {
+    filesystem::path path = filesystem::path(directory_) / key;
+    error_code error;
+    if (!filesystem::is_regular_file(path, error)) {
+        return nullptr;
+    }
+
+    try {
+        return make_unique<mapped_file>(path.string());
+    } catch (runtime_error &) {
+        return nullptr;
+    }
+}
+
+void token_cache::write(const string &key, string_view entry) const {
+    filesystem::path path = filesystem::path(directory_) / key;
+    filesystem::path temporary = path;
+    temporary += ".tmp" + to_string(random_device()());
+
+    {
+        ofstream output(temporary, ios::binary);
+        output.write(entry.data(), entry.size());
+        if (!output) {
+            return;
+        }
+    }
+
+    error_code error;
+    filesystem::rename(temporary, path, error);
+    if (error) {
+        filesystem::remove(temporary, error);
+    }
+}
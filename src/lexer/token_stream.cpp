@@ -0,0 +1,126 @@
+#include "qac/lexer/token_stream.h"
+#include "qac/lexer/delimiter_scanner.h"
+#include "qac/lexer/mapped_file.h"
+#include <istream>
+#include <utility>
+
+using namespace qac;
+using namespace std;
+
+token_stream::token_stream(const string &filename)
+    : token_stream(filename, own_included_files_, own_files_) {
+    included_files_.insert(canonical_path(filename));
+}
+
+token_stream::token_stream(istream &input)
+    : input_(&input),
+      included_files_(own_included_files_),
+      files_(own_files_) {
+    files_.emplace_back();
+}
+
+token_stream::token_stream(const string &filename,
+                           set<string> &included_files,
+                           vector<string> &files)
+    : file_(make_unique<mapped_file>(filename)),
+      scanner_(make_unique<delimiter_scanner>(file_->data(), file_->size())),
+      pos_(file_->data()),
+      end_(file_->data() + file_->size()),
+      included_files_(included_files),
+      files_(files) {
+    lexer_.file_id_ = static_cast<uint16_t>(files_.size());
+    files_.push_back(filename);
+}
+
+token_stream::~token_stream() {}
+
+const token &token_stream::peek() {
+    for (;;) {
+        if (include_) {
+            const token &token = include_->peek();
+            if (!token.is(token_enum::END_OF_FILE)) {
+                return token;
+            }
+            finished_include_ = std::move(include_);
+        }
+
+        if (next_ < line_tokens_.size()) {
+            return line_tokens_[next_];
+        }
+
+        if (!lex_next_line()) {
+            return end_of_file_;
+        }
+    }
+}
+
+token token_stream::next() {
+    token token = peek();
+
+    if (include_) {
+        include_->next();
+    } else if (next_ < line_tokens_.size()) {
+        ++next_;
+    }
+
+    return token;
+}
+
+bool token_stream::lex_next_line() {
+    string_view line;
+    if (!read_line(line)) {
+        return false;
+    }
+
+    line_tokens_.clear();
+    next_ = 0;
+
+    if (scanner_) {
+        lexer_.lex_line(line_tokens_, line, ++line_nr_, *scanner_);
+    } else {
+        delimiter_scanner scanner(line.data(), line.size());
+        lexer_.lex_line(line_tokens_, line, ++line_nr_, scanner);
+    }
+
+    // no token points into the line, so it can go right away
+    if (input_ && line_tokens_.empty()) {
+        lines_.pop_back();
+    }
+
+    for (const auto &include : lexer_.pending_includes_) {
+        if (included_files_.insert(include.path).second) {
+            include_.reset(
+                new token_stream(include.filename, included_files_, files_));
+        }
+    }
+    lexer_.pending_includes_.clear();
+
+    return true;
+}
+
+bool token_stream::read_line(string_view &line) {
+    if (input_) {
+        // only the last line can still hold the last returned token
+        while (lines_.size() > 1) {
+            lines_.pop_front();
+        }
+
+        string text;
+        if (!getline(*input_, text)) {
+            return false;
+        }
+        lines_.push_back(std::move(text));
+        line = lines_.back();
+        return true;
+    }
+
+    if (pos_ == end_) {
+        return false;
+    }
+
+    // same line semantics as std::getline
+    const char *line_end = scanner_->find_newline(pos_, end_);
+    line = string_view(pos_, line_end - pos_);
+    pos_ = line_end == end_ ? end_ : line_end + 1;
+    return true;
+}
@@ -1,14 +1,23 @@
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <future>
 #include <map>
 #include <set>
+#include <sstream>
 
 #include <qac/generator/html-generator.h>
 #include <qac/generator/anki-generator.h>
 #include <qac/lexer/lexer.h>
+#include <qac/lexer/symbol_table.h>
+#include <qac/lexer/token_cache.h>
+#include <qac/lexer/token_stream.h>
+#include <qac/parser/ast_builder.h>
 #include <qac/parser/parser.h>
+#include <qac/util/thread_pool.h>
+#include <qac/util/trace.h>
 
 #include "qac_config.h"
 
@@ -18,8 +27,14 @@ using namespace std;
 DECLARE_bool(listgenerators);
 DECLARE_bool(printcst);
 DECLARE_bool(printtokens);
+DECLARE_bool(printstats);
+DECLARE_bool(intern);
 DECLARE_string(generator);
 DECLARE_string(output);
+DECLARE_int32(threads);
+DECLARE_string(cache_dir);
+DECLARE_string(trace);
+DECLARE_int32(trace_size);
 
 DECLARE_string(chapter);
 DECLARE_string(section);
@@ -33,7 +48,20 @@ void print_tokens(const vector<token> &tokens) {
     }
 }
 
-void print_cst(const cst_node *node, int level = 0, bool last = false,
+void print_stats(const vector<token> &tokens, const interned_tokens &interned) {
+    size_t token_bytes = tokens.capacity() * sizeof(token);
+    size_t interned_bytes = interned.memory_usage();
+
+    cout << "tokens:\t" << tokens.size() << "\n"
+         << "symbols:\t" << interned.symbols().size() << "\n"
+         << "token bytes:\t" << token_bytes << "\n"
+         << "interned bytes:\t" << interned_bytes << "\n"
+         << "compression:\t"
+         << (interned_bytes ? double(token_bytes) / interned_bytes : 0.0)
+         << endl;
+}
+
+void print_cst(const cst_node &node, int level = 0, bool last = false,
                std::set<int> last_set = {}) {
     static const string pipe = "│";
     static const string mux = "├";
@@ -47,16 +75,16 @@ void print_cst(const cst_node *node, int level = 0, bool last = false,
         cout << (last ? lmux : mux) << "─";
     }
 
-    const auto &children = node->children();
+    const auto &children = node.children();
     int nr_children = children.size();
-    cout << (nr_children ? "┬" : "") << to_string(node->type()) << "\n";
+    cout << (nr_children ? "┬" : "") << to_string(node.type()) << "\n";
 
     if (nr_children) {
         for (int i = 0; i < nr_children - 1; ++i) {
-            print_cst(children[i].get(), level + 1, false, last_set);
+            print_cst(children[i], level + 1, false, last_set);
         }
         last_set.insert(level);
-        print_cst(children[nr_children - 1].get(), level + 1, true, last_set);
+        print_cst(children[nr_children - 1], level + 1, true, last_set);
     }
 }
 
@@ -65,6 +93,38 @@ void add_generator(map<string, unique_ptr<generator>> &generator_map,
     generator_map[generator->get_name()] = std::move(generator);
 }
 
+struct render_target {
+    generator *renderer;
+    // empty for stdout
+    string output;
+};
+
+// --generator is a comma separated list of NAME or NAME:OUTPUT, a generator
+// without an output writes to --output.
+vector<render_target> render_targets(
+    const map<string, unique_ptr<generator>> &generator_map) {
+    vector<render_target> targets;
+    istringstream specs(FLAGS_generator);
+    for (string spec; getline(specs, spec, ',');) {
+        size_t colon = spec.find(':');
+        string name = spec.substr(0, colon);
+        auto it = generator_map.find(name);
+        if (it == generator_map.end()) {
+            throw runtime_error("Unknown generator '" + name + "'");
+        }
+        targets.push_back(
+            {it->second.get(),
+             colon == string::npos ? FLAGS_output : spec.substr(colon + 1)});
+    }
+
+    if (count_if(targets.begin(), targets.end(), [](const render_target &t) {
+            return t.output.empty();
+        }) > 1) {
+        throw runtime_error("Only one generator can write to stdout");
+    }
+    return targets;
+}
+
 int main(int argc, char *argv[]) {
     gflags::SetVersionString(QAC_VERSION);
     gflags::SetUsageMessage("[flags] <qa-file>");
@@ -91,40 +151,144 @@ int main(int argc, char *argv[]) {
     const char *input_file = argv[1];
 
     try {
-        lexer::include_file(input_file);
-        std::ifstream input(input_file);
-        if (!input.is_open()) {
-            throw runtime_error("Couldn't open '" + string(input_file) + "'");
+        vector<render_target> targets;
+        vector<unique_ptr<ofstream>> outputs;
+        if (FLAGS_render) {
+            targets = render_targets(generator_map);
+            for (const render_target &target : targets) {
+                target.renderer->set_threads(max(FLAGS_threads, 0));
+                outputs.push_back(nullptr);
+                if (!target.output.empty()) {
+                    outputs.back() = make_unique<ofstream>(target.output);
+                    if (!outputs.back()->is_open()) {
+                        throw runtime_error("Couldn't open '" + target.output +
+                                            "'");
+                    }
+                }
+            }
         }
 
-        bool use_stdout = FLAGS_output.empty();
-        std::ofstream output;
-        if (!use_stdout && FLAGS_render) {
-            output.open(FLAGS_output);
-            if (!output.is_open()) {
-                throw runtime_error("Couldn't open '" + FLAGS_output + "'");
-            }
+        trace_buffer &trace = trace_buffer::instance();
+        trace.set_capacity(max(FLAGS_trace_size, 1));
+        trace.enable(FLAGS_trace);
+        if (!FLAGS_trace.empty() && !trace_compiled(trace_level::RULE)) {
+            cerr << "Tracing is not compiled in, configure with "
+                    "-DQAC_TRACE_LEVEL=1 or 2." << endl;
         }
 
-        lexer lexer;
-        vector<token> tokens = lexer.lex(input);
-        if (FLAGS_printtokens) {
-            print_tokens(tokens);
+        unique_ptr<token_cache> cache;
+        if (!FLAGS_cache_dir.empty()) {
+            cache = make_unique<token_cache>(FLAGS_cache_dir);
         }
 
         parser parser;
-        auto root = parser.parse(tokens);
 
-        if (FLAGS_printcst) {
-            print_cst(root.get());
-        }
+        // The AST is built once and only read while rendering, so every
+        // generator renders it in a thread of its own.
+        auto render = [&](const ast_node &root) {
+            auto render_one = [&](size_t i) {
+                targets[i].renderer->render(
+                    root, outputs[i] ? *outputs[i] : cout);
+            };
+            if (targets.size() == 1) {
+                render_one(0);
+                return;
+            }
 
-        if (FLAGS_render) {
-            generator_map.at(FLAGS_generator)
-                ->generate(root.get(), use_stdout ? cout : output);
+            thread_pool pool(static_cast<unsigned>(targets.size()));
+            vector<future<void>> rendered;
+            for (size_t i = 0; i < targets.size(); ++i) {
+                rendered.push_back(pool.submit([&, i] { render_one(i); }));
+            }
+            for (future<void> &done : rendered) {
+                done.get();
+            }
+        };
+
+        auto use_cst = [&](const cst &root) {
+            if (FLAGS_printcst) {
+                print_cst(root.root());
+            }
+            if (FLAGS_render) {
+                ast_builder builder;
+                parse_event_builder events(builder);
+                root.replay(events);
+                render(*builder.root());
+            }
+        };
+
+        // only --printcst needs the tree, rendering consumes parse events
+        auto parse = [&](token_source &tokens) {
+            if (FLAGS_printcst) {
+                use_cst(parser.parse(tokens));
+            } else if (FLAGS_render) {
+                ast_builder builder;
+                parser.parse(tokens, builder);
+                render(*builder.root());
+            } else {
+                parse_handler check;
+                parser.parse(tokens, check);
+            }
+        };
+
+        if (FLAGS_intern || FLAGS_printstats) {
+            vector<string> files;
+            unique_ptr<interned_tokens> interned;
+            {
+                lexer lexer;
+                lexer.set_threads(max(FLAGS_threads, 0));
+                lexer.set_cache(cache.get());
+                vector<token> tokens = lexer.lex_file(input_file);
+                files = lexer.files();
+                interned = make_unique<interned_tokens>(tokens);
+                if (FLAGS_printstats) {
+                    print_stats(tokens, *interned);
+                }
+            }
+
+            if (FLAGS_printtokens) {
+                for (size_t i = 0; i < interned->size(); ++i) {
+                    cout << (*interned)[i] << endl;
+                }
+            }
+
+            interned_token_source source(*interned);
+            parser.set_files(files);
+            parse(source);
+        } else if (FLAGS_printtokens || FLAGS_threads != 1 || cache) {
+            lexer lexer;
+            lexer.set_threads(max(FLAGS_threads, 0));
+            lexer.set_cache(cache.get());
+            vector<token> tokens = lexer.lex_file(input_file);
+            if (FLAGS_printtokens) {
+                print_tokens(tokens);
+            }
+
+            parser.set_files(lexer.files());
+            if (FLAGS_threads != 1) {
+                // chapters are parsed in parallel into a tree
+                parser.set_threads(max(FLAGS_threads, 0));
+                use_cst(parser.parse(tokens));
+            } else {
+                token_vector_source source(tokens);
+                parse(source);
+            }
+        } else {
+            // lex while parsing, so the tokens are never all in memory
+            token_stream tokens(input_file);
+            parser.set_files(tokens.files());
+            parse(tokens);
+        }
+    } catch (parse_error &e) {
+        for (const string &message : e.messages()) {
+            cerr << "Error: " << message << endl;
         }
     } catch (exception &e) {
         cerr << "Error: " << e.what() << endl;
     }
+
+    if (!FLAGS_trace.empty()) {
+        trace_buffer::instance().dump(cerr);
+    }
     return 0;
 }
@@ -0,0 +1,179 @@
+#include <qac/parser/ast_builder.h>
+#include <qac/util/trace.h>
+
+#include <string>
+
+#include <boost/algorithm/string.hpp>
+
+using namespace qac;
+using namespace std;
+
+namespace {
+
+string_view trimmed(string_view words) {
+    auto is_space = boost::algorithm::is_space();
+    while (!words.empty() && is_space(words.front())) {
+        words.remove_prefix(1);
+    }
+    while (!words.empty() && is_space(words.back())) {
+        words.remove_suffix(1);
+    }
+    return words;
+}
+}
+
+void ast_builder::on_document_end() {
+    // a deck without chapters
+    if (!root_) {
+        root_ = make_unique<ast_root_questions>();
+    }
+}
+
+void ast_builder::on_chapter_begin(string_view caption) {
+    if (!root_) {
+        root_ = make_unique<ast_root_chapters>();
+    }
+
+    state_ = ast_builder_state::IN_CHAPTER;
+    chapter_ = make_unique<ast_chapter>(++nth_chapter_, string(caption) + " ");
+    nth_section_ = 0;
+    nth_subsection_ = 0;
+
+    QAC_TRACE(VISITOR, RULE) << "Chapter " << nth_chapter_ << ": " << caption;
+}
+
+void ast_builder::on_chapter_end() {
+    reinterpret_cast<ast_root_chapters *>(root_.get())
+        ->add_chapter(std::move(chapter_));
+    chapter_.reset();
+}
+
+void ast_builder::on_section_begin(string_view caption) {
+    state_ = ast_builder_state::IN_SECTION;
+    section_ = make_unique<ast_section>(++nth_section_, string(caption) + " ");
+    nth_subsection_ = 0;
+
+    QAC_TRACE(VISITOR, RULE) << nth_chapter_ << " Section " << nth_section_
+                             << ": " << caption;
+}
+
+void ast_builder::on_section_end() {
+    chapter_->add_section(std::move(section_));
+    section_.reset();
+}
+
+void ast_builder::on_subsection_begin(string_view caption) {
+    state_ = ast_builder_state::IN_SUBSECTION;
+    subsection_ =
+        make_unique<ast_subsection>(++nth_subsection_, string(caption) + " ");
+
+    QAC_TRACE(VISITOR, RULE) << nth_chapter_ << "-" << nth_section_
+                             << " Subsection " << nth_subsection_ << ": "
+                             << caption;
+}
+
+void ast_builder::on_subsection_end() {
+    section_->add_subsection(std::move(subsection_));
+    subsection_.reset();
+}
+
+void ast_builder::on_question_end() {
+    if (!root_) {
+        root_ = make_unique<ast_root_questions>();
+    }
+
+    ast_question::ptr question = make_unique<ast_question>(
+        ++nth_question_, std::move(question_text_), std::move(answer_text_));
+
+    question->chapter(chapter_.get());
+    question->section(section_.get());
+    question->subsection(subsection_.get());
+
+    switch (state_) {
+        case ast_builder_state::IN_ROOT:
+            reinterpret_cast<ast_root_questions *>(root_.get())
+                ->add_question(std::move(question));
+            break;
+
+        case ast_builder_state::IN_CHAPTER:
+            chapter_->add_question(std::move(question));
+            break;
+
+        case ast_builder_state::IN_SECTION:
+            section_->add_question(std::move(question));
+            break;
+
+        case ast_builder_state::IN_SUBSECTION:
+            subsection_->add_question(std::move(question));
+            break;
+    }
+
+    QAC_TRACE(VISITOR, RULE) << nth_chapter_ << "-" << nth_section_ << "-"
+                             << nth_subsection_ << " Question "
+                             << nth_question_;
+}
+
+void ast_builder::on_question_text_begin() { text_ = ast_text(); }
+
+void ast_builder::on_question_text_end() {
+    question_text_ = std::move(text_);
+}
+
+void ast_builder::on_answer_text_begin() { text_ = ast_text(); }
+
+void ast_builder::on_answer_text_end() { answer_text_ = std::move(text_); }
+
+void ast_builder::on_text(string_view words) {
+    text_.add(ast_text_enum::TEXT, words);
+}
+
+void ast_builder::on_image(string_view source, int width, int height) {
+    text_.add_image(source, width, height);
+}
+
+void ast_builder::on_latex(string_view body, bool centered) {
+    text_.add(centered ? ast_text_enum::CENTERED_LATEX : ast_text_enum::LATEX,
+              trimmed(body));
+}
+
+void ast_builder::on_bold(string_view words) {
+    text_.add(ast_text_enum::BOLD, trimmed(words));
+}
+
+void ast_builder::on_underlined(string_view words) {
+    text_.add(ast_text_enum::UNDERLINED, trimmed(words));
+}
+
+void ast_builder::on_code(string_view words) {
+    text_.add(ast_text_enum::CODE, trimmed(words));
+}
+
+void ast_builder::on_unordered_list_begin() {
+    text_.add(ast_text_enum::UNORDERED_LIST);
+}
+
+void ast_builder::on_unordered_list_end() { text_.end(); }
+
+void ast_builder::on_ordered_list_begin() {
+    text_.add(ast_text_enum::ORDERED_LIST);
+}
+
+void ast_builder::on_ordered_list_end() { text_.end(); }
+
+void ast_builder::on_list_item_begin() { text_.add(ast_text_enum::LIST_ITEM); }
+
+void ast_builder::on_list_item_end() { text_.end(); }
+
+void ast_builder::on_table_begin() { text_.add(ast_text_enum::TABLE); }
+
+void ast_builder::on_table_end() { text_.end(); }
+
+void ast_builder::on_table_row_begin() { text_.add(ast_text_enum::TABLE_ROW); }
+
+void ast_builder::on_table_row_end() { text_.end(); }
+
+void ast_builder::on_table_cell_begin(cst_alignment_enum alignment) {
+    text_.add_table_cell(alignment);
+}
+
+void ast_builder::on_table_cell_end() { text_.end(); }
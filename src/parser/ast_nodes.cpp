@@ -3,6 +3,25 @@
 using namespace qac;
 using namespace std;
 
+void ast_text::add(ast_text_enum type, string_view words) {
+    element e{type};
+    e.offset = static_cast<uint32_t>(words_.size());
+    e.length = static_cast<uint32_t>(words.size());
+    words_.append(words);
+    elements_.push_back(e);
+}
+
+void ast_text::add_image(string_view source, int width, int height) {
+    add(ast_text_enum::IMAGE, source);
+    elements_.back().width = width;
+    elements_.back().height = height;
+}
+
+void ast_text::add_table_cell(cst_alignment_enum alignment) {
+    add(ast_text_enum::TABLE_CELL);
+    elements_.back().alignment = alignment;
+}
+
 uint16_t ast_question::nth_chapter() const { return chapter_->nth_chapter(); }
 uint16_t ast_question::nth_section() const { return section_->nth_section(); }
 uint16_t ast_question::nth_subsection() const {
@@ -13,3 +32,27 @@ const std::string &ast_question::section() const { return section_->section(); }
 const std::string &ast_question::subsection() const {
     return subsection_->subsection();
 }
+
+bool ast_section::empty() const {
+    if (!questions().empty()) {
+        return false;
+    }
+    for (const ast_subsection::ptr &subsection : subsections_) {
+        if (!subsection->empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ast_chapter::empty() const {
+    if (!questions().empty()) {
+        return false;
+    }
+    for (const ast_section::ptr &section : sections_) {
+        if (!section->empty()) {
+            return false;
+        }
+    }
+    return true;
+}
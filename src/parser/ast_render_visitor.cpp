@@ -1,121 +1,176 @@
 #include <qac/parser/ast_render_visitor.h>
 #include <qac/generator/generator.h>
-
-#include <glog/logging.h>
+#include <qac/util/thread_pool.h>
+#include <qac/util/trace.h>
 
 using namespace qac;
 using namespace std;
 
-void ast_render_visitor::visit(ast_chapter *node) {
-    DLOG_IF(INFO, LOG_VISIT)
+namespace {
+
+const size_t QUESTIONS_PER_TASK = 64;
+const size_t TASKS_PER_WORKER = 4;
+
+// question and answer are buffers for the rendered texts
+void render_question(generator *generator, ostream &os,
+                     const ast_question *node, string &question,
+                     string &answer) {
+    question.clear();
+    generator->render_text(question, node->question());
+    answer.clear();
+    generator->render_text(answer, node->answer());
+    generator->render_question(os, question, answer, node);
+}
+}
+
+void ast_render_visitor::visit(const ast_chapter *node) {
+    QAC_TRACE(VISITOR, RULE)
         << "entering ast_chapter questions: " << node->questions().size()
         << " sections: " << node->sections().size();
 
-    push_text_stream();
-    for (const auto &question : node->questions()) {
-        question->accept(*this);
-    }
-    std::string questions = text_stream().str();
-    pop_text_stream();
-
-    push_text_stream();
-    for (const auto &section : node->sections()) {
-        section->accept(*this);
+    if (!node->empty()) {
+        generator_->render_chapter_begin(out(), node);
+        visit_questions(node);
+        generator_->render_chapter_sections(out(), node);
+        for (const auto &section : node->sections()) {
+            section->accept(*this);
+        }
+        generator_->render_chapter_end(out(), node);
     }
-    std::string sections = text_stream().str();
-    pop_text_stream();
 
-    generator_->render_chapter(text_stream(), node->chapter(), questions,
-                               sections, node);
-
-    DLOG_IF(INFO, LOG_VISIT) << "exiting ast_chapter";
+    QAC_TRACE(VISITOR, RULE) << "exiting ast_chapter";
 }
 
-void ast_render_visitor::visit(ast_question *node) {
-    DLOG_IF(INFO, LOG_VISIT) << "entering ast_question";
-
-    generator_->render_question(text_stream(), node->question(), node->answer(),
-                                node);
+void ast_render_visitor::visit(const ast_question *node) {
+    QAC_TRACE(VISITOR, RULE) << "entering ast_question";
+
+    if (!pool_) {
+        render_question(generator_, os_, node, question_, answer_);
+    } else {
+        // the questions follow the text of the last segment
+        if (questions_.empty()) {
+            out();
+        }
+        questions_.push_back(node);
+        if (questions_.size() == QUESTIONS_PER_TASK) {
+            submit_questions();
+        }
+    }
 
-    DLOG_IF(INFO, LOG_VISIT) << "exiting ast_question";
+    QAC_TRACE(VISITOR, RULE) << "exiting ast_question";
 }
 
-void ast_render_visitor::visit(ast_root_chapters *node) {
-    DLOG_IF(INFO, LOG_VISIT) << "entering ast_root_chapter chapters: "
+void ast_render_visitor::visit(const ast_root_chapters *node) {
+    QAC_TRACE(VISITOR, RULE) << "entering ast_root_chapter chapters: "
                              << node->chapters().size();
 
-    push_text_stream();
+    generator_->render_document_begin(out());
     for (const auto &chapter : node->chapters()) {
         chapter->accept(*this);
     }
-    std::string body = text_stream().str();
-    pop_text_stream();
+    generator_->render_document_end(out());
+    submit_questions();
+    flush(0);
 
-    push_text_stream();
-    generator_->render_document(text_stream(), body);
-    rendered_qa_ = text_stream().str();
-    pop_text_stream();
-
-    DLOG_IF(INFO, LOG_VISIT) << "exiting ast_root_chapter";
+    QAC_TRACE(VISITOR, RULE) << "exiting ast_root_chapter";
 }
 
-void ast_render_visitor::visit(ast_root_questions *node) {
-    DLOG_IF(INFO, LOG_VISIT) << "entering ast_root_questions questions: "
+void ast_render_visitor::visit(const ast_root_questions *node) {
+    QAC_TRACE(VISITOR, RULE) << "entering ast_root_questions questions: "
                              << node->questions().size();
 
-    push_text_stream();
-    for (const auto &question : node->questions()) {
-        question->accept(*this);
-    }
-    std::string body = text_stream().str();
-    pop_text_stream();
+    generator_->render_document_begin(out());
+    visit_questions(node);
+    generator_->render_document_end(out());
+    submit_questions();
+    flush(0);
 
-    push_text_stream();
-    generator_->render_document(text_stream(), body);
-    rendered_qa_ = text_stream().str();
-    pop_text_stream();
-
-    DLOG_IF(INFO, LOG_VISIT) << "exiting ast_root_questions";
+    QAC_TRACE(VISITOR, RULE) << "exiting ast_root_questions";
 }
 
-void ast_render_visitor::visit(ast_section *node) {
-    DLOG_IF(INFO, LOG_VISIT)
+void ast_render_visitor::visit(const ast_section *node) {
+    QAC_TRACE(VISITOR, RULE)
         << "entering ast_section questions: " << node->questions().size()
         << " subsections: " << node->subsections().size();
 
-    push_text_stream();
-    for (const auto &question : node->questions()) {
-        question->accept(*this);
-    }
-    std::string questions = text_stream().str();
-    pop_text_stream();
-
-    push_text_stream();
-    for (const auto &subsection : node->subsections()) {
-        subsection->accept(*this);
+    if (!node->empty()) {
+        generator_->render_section_begin(out(), node);
+        visit_questions(node);
+        generator_->render_section_subsections(out(), node);
+        for (const auto &subsection : node->subsections()) {
+            subsection->accept(*this);
+        }
+        generator_->render_section_end(out(), node);
     }
-    std::string subsections = text_stream().str();
-    pop_text_stream();
 
-    generator_->render_section(text_stream(), node->section(), questions,
-                               subsections, node);
-
-    DLOG_IF(INFO, LOG_VISIT) << "exiting ast_section";
+    QAC_TRACE(VISITOR, RULE) << "exiting ast_section";
 }
 
-void ast_render_visitor::visit(ast_subsection *node) {
-    DLOG_IF(INFO, LOG_VISIT) << "entering ast_subsection questions: "
+void ast_render_visitor::visit(const ast_subsection *node) {
+    QAC_TRACE(VISITOR, RULE) << "entering ast_subsection questions: "
                              << node->questions().size();
 
-    push_text_stream();
+    if (!node->empty()) {
+        generator_->render_subsection_begin(out(), node);
+        visit_questions(node);
+        generator_->render_subsection_end(out(), node);
+    }
+
+    QAC_TRACE(VISITOR, RULE) << "exiting ast_subsection";
+}
+
+void ast_render_visitor::visit_questions(const has_questions *node) {
     for (const auto &question : node->questions()) {
         question->accept(*this);
     }
-    std::string questions = text_stream().str();
-    pop_text_stream();
+}
 
-    generator_->render_subsection(text_stream(), node->subsection(), questions,
-                                  node);
+// A heading after questions starts a new segment.
+ostream &ast_render_visitor::out() {
+    if (!pool_) {
+        return os_;
+    }
 
-    DLOG_IF(INFO, LOG_VISIT) << "exiting ast_subsection";
+    submit_questions();
+    if (segments_.empty() || segments_.back()->questions.valid()) {
+        segments_.push_back(make_unique<segment>());
+        segment_os_ = make_unique<string_ostream>(segments_.back()->text);
+    }
+    return *segment_os_;
+}
+
+void ast_render_visitor::submit_questions() {
+    if (questions_.empty()) {
+        return;
+    }
+
+    segments_.back()->questions =
+        pool_->submit([generator = generator_,
+                       questions = std::move(questions_)] {
+            string rendered;
+            string_ostream os(rendered);
+            string question;
+            string answer;
+            for (const ast_question *node : questions) {
+                render_question(generator, os, node, question, answer);
+            }
+            return rendered;
+        });
+    questions_.clear();
+
+    flush(pool_->size() * TASKS_PER_WORKER);
+}
+
+void ast_render_visitor::flush(size_t keep) {
+    while (segments_.size() > keep) {
+        segment &first = *segments_.front();
+        os_ << first.text;
+        if (first.questions.valid()) {
+            os_ << first.questions.get();
+        }
+        segments_.pop_front();
+    }
+    if (segments_.empty()) {
+        segment_os_.reset();
+    }
 }
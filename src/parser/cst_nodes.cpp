@@ -0,0 +1,212 @@
+#include <qac/parser/cst_nodes.h>
+
+using namespace qac;
+using namespace std;
+
+void cst::open(cst_node_enum type) {
+    index i = static_cast<index>(nodes_.size());
+    if (!open_.empty()) {
+        pending_.push_back(i);
+    }
+
+    nodes_.push_back(node{type});
+    open_.push_back(i);
+    first_word_ = true;
+    pending_marks_.push_back(pending_.size());
+}
+
+void cst::close() {
+    node &n = nodes_[open_.back()];
+    size_t mark = pending_marks_.back();
+    open_.pop_back();
+    pending_marks_.pop_back();
+
+    n.first_child = static_cast<uint32_t>(children_.size());
+    n.child_count = static_cast<uint32_t>(pending_.size() - mark);
+    children_.insert(children_.end(), pending_.begin() + mark,
+                     pending_.end());
+    pending_.resize(mark);
+}
+
+void cst::add_word(string_view word) {
+    node &n = nodes_[open_.back()];
+    if (first_word_) {
+        n.text.offset = static_cast<uint32_t>(text_.size());
+        first_word_ = false;
+    } else {
+        text_ += ' ';
+    }
+
+    text_.append(word);
+    n.text.length = static_cast<uint32_t>(text_.size() - n.text.offset);
+}
+
+void cst::set_image(int width, int height) {
+    node &n = nodes_[open_.back()];
+    n.width = width;
+    n.height = height;
+}
+
+void cst::set_alignment(cst_alignment_enum alignment) {
+    nodes_[open_.back()].alignment = alignment;
+}
+
+void cst::replay(cst_builder &builder) const {
+    if (!nodes_.empty()) {
+        replay(0, builder);
+    }
+}
+
+void cst::replay(index i, cst_builder &builder) const {
+    const node &n = nodes_[i];
+
+    builder.open(n.type);
+    switch (n.type) {
+        case cst_node_enum::TEXT:
+        case cst_node_enum::LATEX_BODY:
+            builder.add_word(text(n));
+            break;
+
+        case cst_node_enum::IMAGE:
+            builder.add_word(text(n));
+            builder.set_image(n.width, n.height);
+            break;
+
+        case cst_node_enum::TABLE_CELL:
+            builder.set_alignment(n.alignment);
+            break;
+
+        default:
+            break;
+    }
+
+    for (uint32_t nth = 0; nth < n.child_count; ++nth) {
+        replay(child(n, nth), builder);
+    }
+    builder.close();
+}
+
+void cst::append_children(const cst &tree) {
+    // the nodes of the tree but its root go behind ours
+    index node_offset = static_cast<index>(nodes_.size()) - 1;
+    uint32_t child_offset = static_cast<uint32_t>(children_.size());
+    uint32_t text_offset = static_cast<uint32_t>(text_.size());
+
+    for (size_t i = 1; i < tree.nodes_.size(); ++i) {
+        node n = tree.nodes_[i];
+        n.first_child += child_offset;
+        n.text.offset += text_offset;
+        nodes_.push_back(n);
+    }
+    for (index child : tree.children_) {
+        children_.push_back(child + node_offset);
+    }
+    text_ += tree.text_;
+
+    const node &root = tree.nodes_[0];
+    for (uint32_t nth = 0; nth < root.child_count; ++nth) {
+        pending_.push_back(tree.child(root, nth) + node_offset);
+    }
+}
+
+size_t cst::memory_usage() const {
+    return nodes_.capacity() * sizeof(node) +
+           children_.capacity() * sizeof(index) + text_.capacity();
+}
+
+namespace {
+
+template <typename T>
+void visit_as(const cst &tree, cst::index index, cst_visitor &visitor) {
+    T node(tree, index);
+    visitor.visit(&node);
+}
+}
+
+void cst_node::accept(cst_visitor &visitor) const {
+    const cst &tree = *tree_;
+
+    switch (type()) {
+        case cst_node_enum::ROOT:
+            // the first child tells a deck of chapters from one of questions
+            if (!children().empty() &&
+                children()[0].type() == cst_node_enum::CHAPTER) {
+                visit_as<cst_root_chapters>(tree, index_, visitor);
+            } else {
+                visit_as<cst_root_questions>(tree, index_, visitor);
+            }
+            break;
+        case cst_node_enum::QUESTION:
+            visit_as<cst_question>(tree, index_, visitor);
+            break;
+        case cst_node_enum::QUESTION_TEXT:
+            visit_as<cst_question_text>(tree, index_, visitor);
+            break;
+        case cst_node_enum::ANSWER_TEXT:
+            visit_as<cst_answer_text>(tree, index_, visitor);
+            break;
+        case cst_node_enum::TEXT:
+            visit_as<cst_text>(tree, index_, visitor);
+            break;
+        case cst_node_enum::LATEX:
+            visit_as<cst_latex>(tree, index_, visitor);
+            break;
+        case cst_node_enum::NORMAL_LATEX:
+            visit_as<cst_normal_latex>(tree, index_, visitor);
+            break;
+        case cst_node_enum::CENTERED_LATEX:
+            visit_as<cst_centered_latex>(tree, index_, visitor);
+            break;
+        case cst_node_enum::LATEX_BODY:
+            visit_as<cst_latex_body>(tree, index_, visitor);
+            break;
+        case cst_node_enum::UNORDERED_LIST:
+            visit_as<cst_unordered_list>(tree, index_, visitor);
+            break;
+        case cst_node_enum::UNORDERED_LIST_ITEM:
+            visit_as<cst_unordered_list_item>(tree, index_, visitor);
+            break;
+        case cst_node_enum::ORDERED_LIST:
+            visit_as<cst_ordered_list>(tree, index_, visitor);
+            break;
+        case cst_node_enum::ORDERED_LIST_ITEM:
+            visit_as<cst_ordered_list_item>(tree, index_, visitor);
+            break;
+        case cst_node_enum::LIST_ITEM_TEXT:
+            visit_as<cst_list_item_text>(tree, index_, visitor);
+            break;
+        case cst_node_enum::BOLD:
+            visit_as<cst_bold>(tree, index_, visitor);
+            break;
+        case cst_node_enum::UNDERLINED:
+            visit_as<cst_underlined>(tree, index_, visitor);
+            break;
+        case cst_node_enum::CODE:
+            visit_as<cst_code>(tree, index_, visitor);
+            break;
+        case cst_node_enum::CHAPTER:
+            visit_as<cst_chapter>(tree, index_, visitor);
+            break;
+        case cst_node_enum::SECTION:
+            visit_as<cst_section>(tree, index_, visitor);
+            break;
+        case cst_node_enum::SUBSECTION:
+            visit_as<cst_subsection>(tree, index_, visitor);
+            break;
+        case cst_node_enum::TABLE:
+            visit_as<cst_table>(tree, index_, visitor);
+            break;
+        case cst_node_enum::TABLE_ROW:
+            visit_as<cst_table_row>(tree, index_, visitor);
+            break;
+        case cst_node_enum::TABLE_CELL:
+            visit_as<cst_table_cell>(tree, index_, visitor);
+            break;
+        case cst_node_enum::TABLE_CELL_TEXT:
+            visit_as<cst_table_cell_text>(tree, index_, visitor);
+            break;
+        case cst_node_enum::IMAGE:
+            visit_as<cst_image>(tree, index_, visitor);
+            break;
+    }
+}
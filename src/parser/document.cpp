@@ -0,0 +1,283 @@
+#include <qac/parser/document.h>
+#include <qac/parser/parser.h>
+#include <qac/util/trace.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace qac;
+using namespace std;
+
+struct document::part {
+    string text;
+    // keeps the included files alive, the tokens point into them
+    unique_ptr<lexer> lexed;
+    // the lines are counted from the first line of the part
+    vector<token> tokens;
+    uint32_t lines = 0;
+
+    cst tree;
+    vector<string> errors;
+    // whether the part can be assembled with the others
+    bool complete = true;
+};
+
+namespace {
+
+bool is_whitespace(const token &token) {
+    return token.is(token_enum::NEW_LINE) || token.is(token_enum::EMPTY_LINE);
+}
+
+// The token as if the part was lexed with the deck, which starts at line.
+token moved(const token &t, uint32_t line) {
+    if (t.file()) {
+        return t;
+    }
+    return token(t.get_token(), t.get_value(), t.line() + line - 1, t.column(),
+                 0);
+}
+
+uint32_t count_lines(const string &text) {
+    uint32_t lines =
+        static_cast<uint32_t>(count(text.begin(), text.end(), '\n'));
+    if (!text.empty() && text.back() != '\n') {
+        ++lines;
+    }
+    return lines;
+}
+}
+
+// The first tokens of the parts, with their trees.
+class document::part_source : public parsed_parts {
+   public:
+    explicit part_source(const document &doc) {
+        for (size_t i = 0; i < doc.parts_.size(); ++i) {
+            const vector<token> &tokens = doc.parts_[i]->tokens;
+            auto first = find_if_not(tokens.begin(), tokens.end(),
+                                     is_whitespace);
+            if (first != tokens.end()) {
+                tokens_.push_back(moved(*first, doc.lines_[i]));
+                parts_.push_back(doc.parts_[i].get());
+            }
+        }
+    }
+
+    const token &peek() override {
+        return next_ != tokens_.size() ? tokens_[next_] : end_of_file_;
+    }
+
+    token next() override {
+        if (next_ == tokens_.size()) {
+            return end_of_file_;
+        }
+        current_ = parts_[next_];
+        return tokens_[next_++];
+    }
+
+    const cst &part_tree() override { return current_->tree; }
+    const vector<string> &part_errors() override { return current_->errors; }
+
+   private:
+    vector<token> tokens_;
+    vector<const part *> parts_;
+    size_t next_ = 0;
+    const part *current_ = nullptr;
+    token end_of_file_ = token(token_enum::END_OF_FILE, "", 0);
+};
+
+document::document(string_view text) {
+    string source(text);
+    lexer lexer;
+    parts_ = split(source, lexer.lex(source.data(), source.size()), true);
+    offsets_ = {0};
+    lines_ = {1};
+    update_offsets(0);
+
+    for (size_t i = 1; i < parts_.size(); ++i) {
+        parse(i);
+    }
+}
+
+document::~document() {}
+
+void document::edit(size_t offset, size_t length, string_view text) {
+    if (offset > size() || length > size() - offset) {
+        throw runtime_error("Edit out of range");
+    }
+
+    // The part in front is lexed again too, the edit may have removed the
+    // heading which separates them.
+    size_t first = part_at(offset);
+    if (first) {
+        --first;
+    }
+    size_t last = part_at(offset + length) + 1;
+
+    string source;
+    for (size_t i = first; i < last; ++i) {
+        source += parts_[i]->text;
+    }
+    source.replace(offset - offsets_[first], length, text);
+
+    // a delimiter left open reaches into the parts after the edit
+    vector<token> tokens;
+    for (;;) {
+        lexer lexer;
+        tokens = lexer.lex(source.data(), source.size());
+        if (!lexer.in_delimiter() || last == parts_.size()) {
+            break;
+        }
+        source += parts_[last++]->text;
+    }
+
+    vector<unique_ptr<part>> parts = split(source, tokens, first == 0);
+    size_t count = parts.size();
+    uint32_t old_lines = lines_[last] - lines_[first];
+
+    parts_.erase(parts_.begin() + first, parts_.begin() + last);
+    parts_.insert(parts_.begin() + first, make_move_iterator(parts.begin()),
+                  make_move_iterator(parts.end()));
+    update_offsets(first);
+
+    reparsed_ = 0;
+    for (size_t i = max<size_t>(first, 1); i < first + count; ++i) {
+        parse(i);
+    }
+
+    // the errors of the parts after the edit name their lines
+    if (lines_[first + count] - lines_[first] != old_lines) {
+        for (size_t i = first + count; i < parts_.size(); ++i) {
+            if (!parts_[i]->errors.empty()) {
+                parse(i);
+            }
+        }
+    }
+
+    QAC_TRACE(PARSER, RULE) << "edit at " << offset << " replaced parts "
+                            << first << " to " << last << " with " << count
+                            << ", " << reparsed_ << " parsed";
+}
+
+cst document::tree() const {
+    for (const unique_ptr<part> &p : parts_) {
+        if (!p->complete) {
+            return parse_all();
+        }
+    }
+
+    part_source source(*this);
+    parser parser;
+    return parser.parse(source);
+}
+
+cst document::parse_all() const {
+    string source = text();
+    lexer lexer;
+    vector<token> tokens = lexer.lex(source.data(), source.size());
+
+    parser parser;
+    parser.set_files(lexer.files());
+    return parser.parse(tokens);
+}
+
+string document::text() const {
+    string text;
+    text.reserve(size());
+    for (const unique_ptr<part> &p : parts_) {
+        text += p->text;
+    }
+    return text;
+}
+
+size_t document::part_at(size_t offset) const {
+    // an empty part in front of the offset has none of its text
+    return upper_bound(offsets_.begin(), offsets_.end() - 1, offset) -
+           offsets_.begin() - 1;
+}
+
+const string &document::part_text(size_t part) const {
+    return parts_[part]->text;
+}
+
+const cst &document::part_tree(size_t part) const {
+    return parts_[part]->tree;
+}
+
+// A part starts at every question or heading at the start of a line. The
+// first part is the text in front of them, if it is the start of the deck.
+vector<unique_ptr<document::part>> document::split(
+    const string &text, const vector<token> &tokens, bool preamble) const {
+    vector<size_t> starts;
+    if (preamble) {
+        starts.push_back(0);
+    }
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        const token &t = tokens[i];
+        bool heading =
+            t.is(token_enum::QUESTION) || t.is(token_enum::CHAPTER) ||
+            t.is(token_enum::SECTION) || t.is(token_enum::SUBSECTION);
+        if (!heading || t.file() ||
+            (i && tokens[i - 1].line() == t.line() &&
+             tokens[i - 1].file() == t.file())) {
+            continue;
+        }
+
+        size_t start = t.get_value().data() - text.data();
+        while (start && text[start - 1] != '\n') {
+            --start;
+        }
+        if (starts.empty() && start) {
+            starts.push_back(0);
+        }
+        starts.push_back(start);
+    }
+    if (starts.empty()) {
+        starts.push_back(0);
+    }
+    starts.push_back(text.size());
+
+    vector<unique_ptr<part>> parts;
+    for (size_t i = 0; i + 1 < starts.size(); ++i) {
+        auto p = make_unique<part>();
+        p->text = text.substr(starts[i], starts[i + 1] - starts[i]);
+        p->lexed = make_unique<lexer>();
+        p->tokens = p->lexed->lex(p->text.data(), p->text.size());
+        p->lines = count_lines(p->text);
+        p->complete = p->lexed->files().empty();
+        parts.push_back(std::move(p));
+    }
+
+    return parts;
+}
+
+// The part sees the first token of the next part, as it would in the deck.
+void document::parse(size_t i) {
+    part &p = *parts_[i];
+
+    vector<token> tokens;
+    tokens.reserve(p.tokens.size() + 1);
+    for (const token &t : p.tokens) {
+        tokens.push_back(moved(t, lines_[i]));
+    }
+    const token *stop = nullptr;
+    if (i + 1 < parts_.size()) {
+        tokens.push_back(moved(parts_[i + 1]->tokens.front(), lines_[i + 1]));
+        stop = &tokens.back();
+    }
+
+    token_vector_source source(tokens);
+    parser parser;
+    p.tree = cst();
+    p.complete = parser.parse_part(source, stop, p.tree, p.errors) &&
+                 p.lexed->files().empty();
+    ++reparsed_;
+}
+
+void document::update_offsets(size_t from) {
+    offsets_.resize(parts_.size() + 1);
+    lines_.resize(parts_.size() + 1);
+    for (size_t i = from; i < parts_.size(); ++i) {
+        offsets_[i + 1] = offsets_[i] + parts_[i]->text.size();
+        lines_[i + 1] = lines_[i] + parts_[i]->lines;
+    }
+}
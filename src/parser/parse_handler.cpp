@@ -0,0 +1,182 @@
+#include <qac/parser/parse_handler.h>
+
+using namespace qac;
+using namespace std;
+
+void parse_event_builder::open(cst_node_enum type) {
+    open_.push_back(frame{type});
+
+    switch (type) {
+        case cst_node_enum::ROOT:
+            handler_.on_document_begin();
+            break;
+        case cst_node_enum::QUESTION:
+            handler_.on_question_begin();
+            break;
+        case cst_node_enum::QUESTION_TEXT:
+            handler_.on_question_text_begin();
+            break;
+        case cst_node_enum::ANSWER_TEXT:
+            handler_.on_answer_text_begin();
+            break;
+        case cst_node_enum::UNORDERED_LIST:
+            handler_.on_unordered_list_begin();
+            break;
+        case cst_node_enum::ORDERED_LIST:
+            handler_.on_ordered_list_begin();
+            break;
+        case cst_node_enum::UNORDERED_LIST_ITEM:
+        case cst_node_enum::ORDERED_LIST_ITEM:
+            handler_.on_list_item_begin();
+            break;
+        case cst_node_enum::TABLE:
+            handler_.on_table_begin();
+            break;
+        case cst_node_enum::TABLE_ROW:
+            handler_.on_table_row_begin();
+            break;
+        case cst_node_enum::TABLE_CELL_TEXT: {
+            // the alignment of the cell is known by now
+            frame &cell = open_[open_.size() - 2];
+            cell.begun = true;
+            handler_.on_table_cell_begin(cell.alignment);
+            break;
+        }
+        case cst_node_enum::TEXT:
+        case cst_node_enum::LATEX_BODY:
+        case cst_node_enum::IMAGE:
+            words_.clear();
+            first_word_ = true;
+            width_ = -1;
+            height_ = -1;
+            break;
+        default:
+            break;
+    }
+}
+
+void parse_event_builder::close() {
+    cst_node_enum type = open_.back().type;
+    bool begun = open_.back().begun;
+    open_.pop_back();
+
+    switch (type) {
+        case cst_node_enum::ROOT:
+            handler_.on_document_end();
+            break;
+        case cst_node_enum::QUESTION:
+            handler_.on_question_end();
+            break;
+        case cst_node_enum::QUESTION_TEXT:
+            handler_.on_question_text_end();
+            break;
+        case cst_node_enum::ANSWER_TEXT:
+            handler_.on_answer_text_end();
+            break;
+        case cst_node_enum::TEXT:
+            text_closed();
+            break;
+        case cst_node_enum::LATEX_BODY:
+            handler_.on_latex(words_, !open_.empty() &&
+                                          open_.back().type ==
+                                              cst_node_enum::CENTERED_LATEX);
+            break;
+        case cst_node_enum::IMAGE:
+            handler_.on_image(words_, width_, height_);
+            break;
+        case cst_node_enum::UNORDERED_LIST:
+            handler_.on_unordered_list_end();
+            break;
+        case cst_node_enum::ORDERED_LIST:
+            handler_.on_ordered_list_end();
+            break;
+        case cst_node_enum::UNORDERED_LIST_ITEM:
+        case cst_node_enum::ORDERED_LIST_ITEM:
+            handler_.on_list_item_end();
+            break;
+        case cst_node_enum::CHAPTER:
+            if (begun) {
+                handler_.on_chapter_end();
+            }
+            break;
+        case cst_node_enum::SECTION:
+            if (begun) {
+                handler_.on_section_end();
+            }
+            break;
+        case cst_node_enum::SUBSECTION:
+            if (begun) {
+                handler_.on_subsection_end();
+            }
+            break;
+        case cst_node_enum::TABLE:
+            handler_.on_table_end();
+            break;
+        case cst_node_enum::TABLE_ROW:
+            handler_.on_table_row_end();
+            break;
+        case cst_node_enum::TABLE_CELL:
+            // the cell closing a row has no text and is no cell of its own
+            if (begun) {
+                handler_.on_table_cell_end();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// A text is a caption, a bold, underlined or code span or a plain text,
+// depending on where it is.
+void parse_event_builder::text_closed() {
+    if (open_.empty()) {
+        handler_.on_text(words_);
+        return;
+    }
+
+    frame &parent = open_.back();
+    switch (parent.type) {
+        case cst_node_enum::CHAPTER:
+            parent.begun = true;
+            handler_.on_chapter_begin(words_);
+            break;
+        case cst_node_enum::SECTION:
+            parent.begun = true;
+            handler_.on_section_begin(words_);
+            break;
+        case cst_node_enum::SUBSECTION:
+            parent.begun = true;
+            handler_.on_subsection_begin(words_);
+            break;
+        case cst_node_enum::BOLD:
+            handler_.on_bold(words_);
+            break;
+        case cst_node_enum::UNDERLINED:
+            handler_.on_underlined(words_);
+            break;
+        case cst_node_enum::CODE:
+            handler_.on_code(words_);
+            break;
+        default:
+            handler_.on_text(words_);
+            break;
+    }
+}
+
+void parse_event_builder::add_word(string_view word) {
+    if (first_word_) {
+        first_word_ = false;
+    } else {
+        words_ += ' ';
+    }
+    words_.append(word);
+}
+
+void parse_event_builder::set_image(int width, int height) {
+    width_ = width;
+    height_ = height;
+}
+
+void parse_event_builder::set_alignment(cst_alignment_enum alignment) {
+    open_.back().alignment = alignment;
+}
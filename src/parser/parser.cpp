@@ -1,11 +1,12 @@
 #include "qac/parser/parser.h"
 
+#include <future>
 #include <set>
 #include <iostream>
 #include <sstream>
 
-#include <glog/logging.h>
-#include <boost/algorithm/string.hpp>
+#include <qac/util/thread_pool.h>
+#include <qac/util/trace.h>
 
 /*
  * The grammar
@@ -166,657 +167,819 @@
  *                                   | IMAGE VALID_ANSWER_TEXT
  *                                   | EMPTY_WORD
  *
+ * The right-recursive OPT_* and VALID_*_TEXT rules are repetitions. They are
+ * parsed in loops and every repeated element becomes a sibling child of the
+ * enclosing node, e.g. the questions of a chapter are children of CHAPTER.
+ * That way the stack depth does not grow with the size of the deck.
+ *
  */
 
 using namespace qac;
 using namespace std;
 
-unique_ptr<cst_node> parser::parse(const std::vector<token> &tokens) {
-    DLOG(INFO) << "Start parsing";
+namespace {
+
+// The tokens each element of a text starts with. A text rule goes on while
+// the next token is in its FIRST set, which is one mask test.
+constexpr token_set INLINE_FIRST = {
+    token_enum::WORD,         token_enum::IMAGE,
+    token_enum::LATEX_OPENING, token_enum::LATEX_CENTERED_OPENING,
+    token_enum::BOLD_OPENING, token_enum::UNDERLINE_OPENING,
+    token_enum::CODE_OPENING};
+constexpr token_set LIST_FIRST = {token_enum::UNORDERED_LIST_ITEM,
+                                  token_enum::ORDERED_LIST_ITEM};
+constexpr token_set TABLE_FIRST = {token_enum::TABLE_DIVIDER};
+
+constexpr token_set QUESTION_TEXT_FIRST = INLINE_FIRST;
+constexpr token_set ANSWER_TEXT_FIRST = INLINE_FIRST | LIST_FIRST | TABLE_FIRST;
+constexpr token_set LIST_ITEM_TEXT_FIRST = INLINE_FIRST | TABLE_FIRST;
+constexpr token_set TABLE_CELL_TEXT_FIRST = INLINE_FIRST | LIST_FIRST;
+
+constexpr token_set TABLE_CELLS = {
+    token_enum::TABLE_CELL, token_enum::TABLE_CELL_LEFT_ALIGNED,
+    token_enum::TABLE_CELL_RIGHT_ALIGNED,
+    token_enum::TABLE_CELL_CENTER_ALIGNED};
+constexpr token_set HEADINGS = {token_enum::QUESTION, token_enum::CHAPTER,
+                                token_enum::SECTION, token_enum::SUBSECTION};
+// what may follow a question or a caption
+constexpr token_set HEADING_FOLLOW =
+    HEADINGS | token_set{token_enum::END_OF_FILE};
+constexpr token_set WHITESPACE = {token_enum::NEW_LINE,
+                                  token_enum::EMPTY_LINE};
+
+// The CHAPTER tokens starting a line, if the deck is one of chapters. The
+// parser can't take any of them for something else, so a deck can be split
+// there.
+vector<size_t> find_chapters(const vector<token> &tokens) {
+    vector<size_t> chapters;
+
+    size_t i = 0;
+    while (i < tokens.size() && WHITESPACE.contains(tokens[i].get_token())) {
+        ++i;
+    }
+    if (i == tokens.size() || !tokens[i].is(token_enum::CHAPTER)) {
+        return chapters;
+    }
 
-    current_ = lookahead_ = cbegin(tokens);
-    end_ = cend(tokens);
+    chapters.push_back(i);
+    for (++i; i < tokens.size(); ++i) {
+        if (tokens[i].is(token_enum::CHAPTER) &&
+            (tokens[i].line() != tokens[i - 1].line() ||
+             tokens[i].file() != tokens[i - 1].file())) {
+            chapters.push_back(i);
+        }
+    }
+
+    return chapters;
+}
+}
 
-    while (current_ != end_) {
-        DLOG(INFO) << *current_++;
+cst parser::parse(const std::vector<token> &tokens) {
+    if (threads_ != 1) {
+        vector<size_t> chapters = find_chapters(tokens);
+        if (chapters.size() > 1) {
+            return parse_chapters(tokens, chapters);
+        }
     }
 
-    return parse_root();
+    token_vector_source source(tokens);
+    return parse(source);
 }
 
-bool parser::match(token_enum token) {
-    if (lookahead_->get_token() == token) {
-        DLOG(INFO) << "matched " << token;
-        current_ = lookahead_;
-        cur_line_ = current_->line();
-        lookahead_++;
-        return true;
-    } else {
-        DLOG(ERROR) << "can't match " << token;
+// Every chapter is parsed into a tree of its own by a parser of its own. The
+// part of a parser reaches up to the next chapter, where it stops, so it sees
+// the same tokens as a single parser would.
+cst parser::parse_chapters(const std::vector<token> &tokens,
+                           const std::vector<size_t> &chapters) {
+    QAC_TRACE(PARSER, RULE) << "Parsing " << chapters.size()
+                            << " chapters in parallel";
+
+    struct part {
+        cst tree;
+        vector<string> errors;
+    };
 
-        std::ostringstream oss;
+    thread_pool pool(threads_);
+    vector<future<part>> parts;
+    for (size_t i = 0; i < chapters.size(); ++i) {
+        parts.push_back(pool.submit([&, i] {
+            // the first part starts with the whitespace before it
+            size_t begin = i ? chapters[i] : 0;
+            token_vector_source source(tokens.cbegin() + begin, tokens.cend());
+
+            parser chapter;
+            chapter.files_ = files_;
+            chapter.tokens_ = &source;
+            if (i + 1 < chapters.size()) {
+                chapter.stop_ = &tokens[chapters[i + 1]];
+            }
 
-        oss << "Line " << cur_line_ << ": Match failed. Expected " << token
-            << ", but got " << lookahead_->get_token() << ".";
+            part result;
+            chapter.builder_ = &result.tree;
+            chapter.open_node(cst_node_enum::ROOT);
+            chapter.parse_deck(token_enum::CHAPTER);
+            chapter.close_node();
+            result.errors = std::move(chapter.errors_);
+            return result;
+        }));
+    }
 
-        throw runtime_error(oss.str());
+    // the parts are joined in order while the later ones are parsed
+    cst tree;
+    vector<string> errors;
+    tree.open(cst_node_enum::ROOT);
+    for (future<part> &f : parts) {
+        part result = f.get();
+        errors.insert(errors.end(), result.errors.begin(), result.errors.end());
+        if (errors.empty()) {
+            tree.append_children(result.tree);
+        }
     }
+    tree.close();
 
-    return false;
+    if (!errors.empty()) {
+        throw parse_error(std::move(errors));
+    }
+    return tree;
 }
 
-token_enum parser::lookahead() {
-    skip_whitespace();
-    return lookahead_ != end_ ? lookahead_->get_token()
-                              : token_enum::END_OF_FILE;
+cst parser::parse(token_source &tokens) {
+    cst tree;
+    build(tokens, tree);
+    return tree;
 }
 
-void parser::skip_whitespace() {
-    while (lookahead_ != end_ &&
-           (lookahead_->get_token() == token_enum::NEW_LINE ||
-            lookahead_->get_token() == token_enum::EMPTY_LINE)) {
-        lookahead_++;
-        cur_line_++;
+void parser::parse(const std::vector<token> &tokens, parse_handler &handler) {
+    token_vector_source source(tokens);
+    parse(source, handler);
+}
+
+void parser::parse(token_source &tokens, parse_handler &handler) {
+    parse_event_builder events(handler);
+    build(tokens, events);
+}
+
+bool parser::parse_part(token_source &tokens, const token *stop, cst &tree,
+                        std::vector<std::string> &errors) {
+    tokens_ = &tokens;
+    builder_ = &tree;
+    stop_ = stop;
+    ahead_ = nullptr;
+    parts_ = nullptr;
+    child_counts_.clear();
+    errors_.clear();
+
+    open_node(cst_node_enum::ROOT);
+    token_enum heading = lookahead();
+    if (heading == token_enum::CHAPTER || heading == token_enum::SECTION ||
+        heading == token_enum::SUBSECTION) {
+        parse_heading(heading);
     }
+    parse_questions();
+    bool complete = lookahead() == token_enum::END_OF_FILE;
+    close_node();
+
+    builder_ = nullptr;
+    stop_ = nullptr;
+    errors = std::move(errors_);
+    return complete;
 }
 
-void parser::no_rule_found(cst_node_enum nenum) {
-    std::ostringstream oss;
+cst parser::parse(parsed_parts &parts) {
+    cst tree;
+    build(parts, tree, &parts);
+    return tree;
+}
 
-    oss << "Line " << cur_line_ << ": Trying to parse " << nenum
-        << ", but found no applicable rule.";
+void parser::build(token_source &tokens, cst_builder &builder,
+                   parsed_parts *parts) {
+    QAC_TRACE(PARSER, RULE) << "Start parsing";
+
+    tokens_ = &tokens;
+    builder_ = &builder;
+    parts_ = parts;
+    stop_ = nullptr;
+    ahead_ = nullptr;
+    child_counts_.clear();
+    errors_.clear();
+    parse_root();
+    builder_ = nullptr;
+    parts_ = nullptr;
+
+    if (!errors_.empty()) {
+        throw parse_error(std::move(errors_));
+    }
+}
 
-    throw runtime_error(oss.str());
+void parser::open_node(cst_node_enum type) {
+    if (!child_counts_.empty()) {
+        ++child_counts_.back();
+    }
+    child_counts_.push_back(0);
+    builder_->open(type);
 }
 
-std::unique_ptr<cst_node> parser::parse_root() {
-    DLOG(INFO) << "parse_root";
-    unique_ptr<cst_node> ret = nullptr;
+void parser::close_node() {
+    child_counts_.pop_back();
+    builder_->close();
+}
 
-    switch (lookahead()) {
-        case token_enum::QUESTION:
-            ret = make_unique<cst_root_questions>();
-            ret->add_child(parse_question());
-            break;
+// Records the error and unwinds to the next rule which recovers. The tree
+// is incomplete from now on, so nothing more is built.
+void parser::error(const std::string &message) {
+    errors_.push_back(message);
+    builder_ = &discard_;
+    throw recovery();
+}
 
-        case token_enum::CHAPTER:
-            ret = make_unique<cst_root_chapters>();
-            ret->add_child(parse_chapter());
-            break;
+// A heading on the line of the token before it, as in "Q: Q:", is a typo
+// and skipped like any other token.
+void parser::skip_to_heading() {
+    token previous = current_;
+    for (;; previous = advance()) {
+        const token &next = tokens_->peek();
+        if (next.is(token_enum::END_OF_FILE) ||
+            (HEADINGS.contains(next.get_token()) &&
+             (next.line() != previous.line() ||
+              next.file() != previous.file()))) {
+            QAC_TRACE(PARSER, RULE) << "recovering at " << next;
+            return;
+        }
+    }
+}
 
-        default:
-            no_rule_found(cst_node_enum::ROOT);
-            break;
+// A question or heading ends where the next one starts. Anything else is
+// reported within the rule, so the following questions still go where they
+// belong.
+void parser::expect_heading() {
+    if (!HEADING_FOLLOW.contains(lookahead())) {
+        no_rule_found(cst_node_enum::ROOT);
     }
+}
+
+// Takes the tree of the part starting at the next token, or its errors.
+void parser::append_part(token_enum token) {
+    match(token);
 
-    return ret;
+    const vector<string> &errors = parts_->part_errors();
+    if (!errors.empty()) {
+        errors_.insert(errors_.end(), errors.begin(), errors.end());
+        builder_ = &discard_;
+    }
+    if (builder_ != &discard_) {
+        static_cast<cst *>(builder_)->append_children(parts_->part_tree());
+    }
 }
 
-std::unique_ptr<cst_node> parser::parse_question(bool optional) {
-    DLOG(INFO) << "parse_question optional? " << optional;
-    unique_ptr<cst_node> ret = make_unique<cst_question>();
+bool parser::match(token_enum token) {
+    if (tokens_->peek().get_token() == token) {
+        current_ = advance();
+        QAC_TRACE(PARSER, TOKEN) << "matched " << current_;
+        return true;
+    } else {
+        QAC_TRACE(PARSER, RULE) << "can't match " << token;
+
+        std::ostringstream oss;
 
-    if (lookahead() == token_enum::QUESTION) {
-        match(token_enum::QUESTION);
-        ret->add_child(parse_question_text());
-        match(token_enum::ANSWER);
-        ret->add_child(parse_answer_text());
+        oss << location() << ": Match failed. Expected " << token
+            << ", but got " << tokens_->peek().get_token() << ".";
 
-        ret->add_child(parse_question(true));
-    } else if (!optional) {
-        no_rule_found(cst_node_enum::QUESTION);
+        error(oss.str());
     }
 
-    return ret;
+    return false;
 }
 
-std::unique_ptr<cst_node> parser::parse_question_text(bool optional) {
-    DLOG(INFO) << "parse_question_text optional? " << optional;
-    unique_ptr<cst_node> ret = make_unique<cst_question_text>();
+token parser::advance() {
+    ahead_ = nullptr;
+    return tokens_->next();
+}
 
-    switch (lookahead()) {
-        case token_enum::WORD:
-            ret->add_child(parse_text());
-            ret->add_child(parse_question_text(true));
-            break;
+// The rules ask for the next token again and again, the whitespace in front
+// of it is only skipped once.
+token_enum parser::lookahead() {
+    if (!ahead_) {
+        skip_whitespace();
+        ahead_ = &tokens_->peek();
+    }
+    if (ahead_ == stop_) {
+        return token_enum::END_OF_FILE;
+    }
+    return ahead_->get_token();
+}
 
-        case token_enum::IMAGE:
-            ret->add_child(parse_image());
-            ret->add_child(parse_question_text(true));
-            break;
+void parser::skip_whitespace() {
+    while (WHITESPACE.contains(tokens_->peek().get_token())) {
+        advance();
+    }
+}
 
-        case token_enum::LATEX_OPENING:
-        case token_enum::LATEX_CENTERED_OPENING:
-            ret->add_child(parse_latex());
-            ret->add_child(parse_question_text(true));
-            break;
+void parser::no_rule_found(cst_node_enum nenum) {
+    std::ostringstream oss;
 
-        case token_enum::BOLD_OPENING:
-            ret->add_child(parse_bold());
-            ret->add_child(parse_question_text(true));
-            break;
+    oss << location() << ": Trying to parse " << nenum
+        << ", but found no applicable rule.";
 
-        case token_enum::UNDERLINE_OPENING:
-            ret->add_child(parse_underlined());
-            ret->add_child(parse_question_text(true));
-            break;
+    error(oss.str());
+}
 
-        case token_enum::CODE_OPENING:
-            ret->add_child(parse_code());
-            ret->add_child(parse_question_text(true));
-            break;
+// Where the parser got stuck: the next token, or the last matched one at the
+// end of the input.
+std::string parser::location() {
+    token stuck = tokens_->peek();
+    if (stuck.is(token_enum::END_OF_FILE)) {
+        stuck = current_;
+    }
 
-        default:
-            if (!optional) {
-                no_rule_found(cst_node_enum::QUESTION_TEXT);
-                return nullptr;
-            }
-            break;
+    std::ostringstream oss;
+    if (files_ && stuck.file() && stuck.file() < files_->size()) {
+        oss << (*files_)[stuck.file()] << ": ";
+    }
+    oss << "Line " << stuck.line();
+    if (stuck.column()) {
+        oss << ", column " << stuck.column();
     }
 
-    return ret;
+    return oss.str();
 }
 
-std::unique_ptr<cst_node> parser::parse_answer_text(bool optional) {
-    DLOG(INFO) << "parse_answer_text optional? " << optional;
-    unique_ptr<cst_node> ret = make_unique<cst_answer_text>();
+void parser::parse_root() {
+    QAC_TRACE(PARSER, RULE) << "parse_root";
+    open_node(cst_node_enum::ROOT);
 
-    switch (lookahead()) {
-        case token_enum::WORD:
-            ret->add_child(parse_text());
-            ret->add_child(parse_answer_text(true));
-            break;
+    // a deck of questions or of chapters, the first one tells
+    parse_deck(token_enum::END_OF_FILE);
 
-        case token_enum::IMAGE:
-            ret->add_child(parse_image());
-            ret->add_child(parse_answer_text(true));
-            break;
+    close_node();
+}
 
-        case token_enum::LATEX_OPENING:
-        case token_enum::LATEX_CENTERED_OPENING:
-            ret->add_child(parse_latex());
-            ret->add_child(parse_answer_text(true));
-            break;
+void parser::parse_deck(token_enum deck) {
+    do {
+        token_enum next = lookahead();
+        if (deck == token_enum::END_OF_FILE &&
+            (next == token_enum::QUESTION || next == token_enum::CHAPTER)) {
+            deck = next;
+        }
 
-        case token_enum::UNORDERED_LIST_ITEM:
-            ret->add_child(parse_unordered_list());
-            ret->add_child(parse_answer_text(true));
-            break;
+        if (deck == token_enum::QUESTION && next == token_enum::QUESTION) {
+            parse_questions();
+        } else if (deck == token_enum::CHAPTER &&
+                   next == token_enum::CHAPTER) {
+            parse_chapter();
+        } else {
+            // what doesn't fit in the deck is reported, but a heading or
+            // question out of place is still checked
+            recoverable([&] { no_rule_found(cst_node_enum::ROOT); });
+            switch (lookahead()) {
+                case token_enum::QUESTION:
+                    if (deck == token_enum::CHAPTER) {
+                        parse_question();
+                    }
+                    break;
+                case token_enum::CHAPTER:
+                    if (deck == token_enum::QUESTION) {
+                        parse_chapter();
+                    }
+                    break;
+                case token_enum::SECTION:
+                    parse_section();
+                    break;
+                case token_enum::SUBSECTION:
+                    parse_subsection();
+                    break;
+                default:
+                    break;
+            }
+        }
+    } while (lookahead() != token_enum::END_OF_FILE);
+}
 
-        case token_enum::ORDERED_LIST_ITEM:
-            ret->add_child(parse_ordered_list());
-            ret->add_child(parse_answer_text(true));
-            break;
+// OPT_QUESTION: the questions become siblings in the open node.
+void parser::parse_questions() {
+    while (lookahead() == token_enum::QUESTION) {
+        parse_question();
+    }
+}
 
-        case token_enum::BOLD_OPENING:
-            ret->add_child(parse_bold());
-            ret->add_child(parse_answer_text(true));
-            break;
+void parser::parse_question() {
+    QAC_TRACE(PARSER, RULE) << "parse_question";
+    if (parts_) {
+        recoverable([&] { append_part(token_enum::QUESTION); });
+        return;
+    }
+    open_node(cst_node_enum::QUESTION);
+
+    recoverable([&] {
+        if (lookahead() == token_enum::QUESTION) {
+            match(token_enum::QUESTION);
+            parse_question_text();
+            match(token_enum::ANSWER);
+            parse_answer_text();
+            expect_heading();
+        } else {
+            no_rule_found(cst_node_enum::QUESTION);
+        }
+    });
 
-        case token_enum::UNDERLINE_OPENING:
-            ret->add_child(parse_underlined());
-            ret->add_child(parse_answer_text(true));
-            break;
+    close_node();
+}
 
-        case token_enum::CODE_OPENING:
-            ret->add_child(parse_code());
-            ret->add_child(parse_answer_text(true));
-            break;
+void parser::parse_question_text() {
+    QAC_TRACE(PARSER, RULE) << "parse_question_text";
+    open_node(cst_node_enum::QUESTION_TEXT);
 
-        case token_enum::TABLE_DIVIDER:
-            ret->add_child(parse_table());
-            ret->add_child(parse_answer_text(true));
-            break;
+    parse_elements(QUESTION_TEXT_FIRST);
 
-        default:
-            if (!optional) {
-                no_rule_found(cst_node_enum::ANSWER_TEXT);
-                return nullptr;
-            }
-            break;
+    if (child_counts_.back() == 0) {
+        no_rule_found(cst_node_enum::QUESTION_TEXT);
+    }
+
+    close_node();
+}
+
+void parser::parse_answer_text() {
+    QAC_TRACE(PARSER, RULE) << "parse_answer_text";
+    open_node(cst_node_enum::ANSWER_TEXT);
+
+    parse_elements(ANSWER_TEXT_FIRST);
+
+    if (child_counts_.back() == 0) {
+        no_rule_found(cst_node_enum::ANSWER_TEXT);
     }
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_text() {
-    DLOG(INFO) << "parse_text";
-    unique_ptr<cst_node> ret = make_unique<cst_text>();
+// The elements of a text, as long as the next token starts one.
+void parser::parse_elements(token_set first) {
+    for (token_enum next; first.contains(next = lookahead());) {
+        switch (next) {
+            case token_enum::WORD:
+                parse_text();
+                break;
+
+            case token_enum::IMAGE:
+                parse_image();
+                break;
+
+            case token_enum::LATEX_OPENING:
+            case token_enum::LATEX_CENTERED_OPENING:
+                parse_latex();
+                break;
+
+            case token_enum::UNORDERED_LIST_ITEM:
+                parse_unordered_list();
+                break;
+
+            case token_enum::ORDERED_LIST_ITEM:
+                parse_ordered_list();
+                break;
+
+            case token_enum::BOLD_OPENING:
+                parse_bold();
+                break;
+
+            case token_enum::UNDERLINE_OPENING:
+                parse_underlined();
+                break;
+
+            case token_enum::CODE_OPENING:
+                parse_code();
+                break;
+
+            case token_enum::TABLE_DIVIDER:
+                parse_table();
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+void parser::parse_text() {
+    QAC_TRACE(PARSER, RULE) << "parse_text";
+    open_node(cst_node_enum::TEXT);
 
     do {
         match(token_enum::WORD);
-
-        cst_text *ptext = dynamic_cast<cst_text *>(ret.get());
-        ptext->add_word(current_->get_value());
+        builder_->add_word(current_.get_value());
     } while (lookahead() == token_enum::WORD);
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_latex() {
-    DLOG(INFO) << "parse_latex";
-    unique_ptr<cst_node> ret = make_unique<cst_latex>();
+void parser::parse_latex() {
+    QAC_TRACE(PARSER, RULE) << "parse_latex";
+    open_node(cst_node_enum::LATEX);
 
     switch (lookahead()) {
         case token_enum::LATEX_OPENING:
-            ret->add_child(parse_normal_latex());
+            parse_normal_latex();
             break;
 
         case token_enum::LATEX_CENTERED_OPENING:
-            ret->add_child(parse_centered_latex());
+            parse_centered_latex();
             break;
 
         default:
             no_rule_found(cst_node_enum::LATEX);
-            return nullptr;
     }
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_normal_latex() {
-    DLOG(INFO) << "parse_normal_latex";
-    unique_ptr<cst_node> ret = make_unique<cst_normal_latex>();
+void parser::parse_normal_latex() {
+    QAC_TRACE(PARSER, RULE) << "parse_normal_latex";
+    open_node(cst_node_enum::NORMAL_LATEX);
 
     match(token_enum::LATEX_OPENING);
-    ret->add_child(parse_latex_body());
+    parse_latex_body();
     match(token_enum::LATEX_CLOSING);
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_centered_latex() {
-    DLOG(INFO) << "parse_centered_latex";
-    unique_ptr<cst_node> ret = make_unique<cst_centered_latex>();
+void parser::parse_centered_latex() {
+    QAC_TRACE(PARSER, RULE) << "parse_centered_latex";
+    open_node(cst_node_enum::CENTERED_LATEX);
 
     match(token_enum::LATEX_CENTERED_OPENING);
-    ret->add_child(parse_latex_body());
+    parse_latex_body();
     match(token_enum::LATEX_CENTERED_CLOSING);
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_latex_body() {
-    DLOG(INFO) << "parse_latex_body";
-    unique_ptr<cst_node> ret = make_unique<cst_latex_body>();
+void parser::parse_latex_body() {
+    QAC_TRACE(PARSER, RULE) << "parse_latex_body";
+    open_node(cst_node_enum::LATEX_BODY);
 
     do {
         match(token_enum::LATEX_CODE);
-
-        cst_latex_body *platex = dynamic_cast<cst_latex_body *>(ret.get());
-        platex->add_word(current_->get_value());
+        builder_->add_word(current_.get_value());
     } while (lookahead() == token_enum::LATEX_CODE);
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_unordered_list() {
-    DLOG(INFO) << "parse_unordered_list";
-    unique_ptr<cst_node> ret = make_unique<cst_unordered_list>();
+void parser::parse_unordered_list() {
+    QAC_TRACE(PARSER, RULE) << "parse_unordered_list";
+    open_node(cst_node_enum::UNORDERED_LIST);
 
-    if (lookahead() == token_enum::UNORDERED_LIST_ITEM) {
-        ret->add_child(parse_unordered_list_item());
-    } else {
+    if (lookahead() != token_enum::UNORDERED_LIST_ITEM) {
         no_rule_found(cst_node_enum::UNORDERED_LIST);
-        return nullptr;
     }
 
-    return ret;
+    do {
+        parse_unordered_list_item();
+    } while (lookahead() == token_enum::UNORDERED_LIST_ITEM);
+
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_unordered_list_item(bool optional) {
-    DLOG(INFO) << "parse_unordered_list_item optional? " << optional;
-    unique_ptr<cst_node> ret = make_unique<cst_unordered_list_item>();
+void parser::parse_unordered_list_item() {
+    QAC_TRACE(PARSER, RULE) << "parse_unordered_list_item";
+    open_node(cst_node_enum::UNORDERED_LIST_ITEM);
 
-    switch (lookahead()) {
-        case token_enum::UNORDERED_LIST_ITEM:
-            match(token_enum::UNORDERED_LIST_ITEM);
-            ret->add_child(parse_list_item_text());
-            ret->add_child(parse_unordered_list_item(true));
-            break;
+    match(token_enum::UNORDERED_LIST_ITEM);
+    parse_list_item_text();
 
-        default:
-            if (!optional) {
-                no_rule_found(cst_node_enum::UNORDERED_LIST_ITEM);
-            }
-            break;
-    }
-
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_ordered_list() {
-    DLOG(INFO) << "parse_ordered_list";
-    unique_ptr<cst_node> ret = make_unique<cst_ordered_list>();
+void parser::parse_ordered_list() {
+    QAC_TRACE(PARSER, RULE) << "parse_ordered_list";
+    open_node(cst_node_enum::ORDERED_LIST);
 
-    if (lookahead() == token_enum::ORDERED_LIST_ITEM) {
-        ret->add_child(parse_ordered_list_item());
-    } else {
+    if (lookahead() != token_enum::ORDERED_LIST_ITEM) {
         no_rule_found(cst_node_enum::ORDERED_LIST);
-        return nullptr;
     }
 
-    return ret;
-}
-
-std::unique_ptr<cst_node> parser::parse_ordered_list_item(bool optional) {
-    DLOG(INFO) << "parse_ordered_list_item optional? " << optional;
-    unique_ptr<cst_node> ret = make_unique<cst_ordered_list_item>();
-
-    switch (lookahead()) {
-        case token_enum::ORDERED_LIST_ITEM:
-            match(token_enum::ORDERED_LIST_ITEM);
-            ret->add_child(parse_list_item_text());
-            ret->add_child(parse_ordered_list_item(true));
-            break;
-
-        default:
-            if (!optional) {
-                no_rule_found(cst_node_enum::ORDERED_LIST_ITEM);
-            }
-            break;
-    }
+    do {
+        parse_ordered_list_item();
+    } while (lookahead() == token_enum::ORDERED_LIST_ITEM);
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_list_item_text(bool optional) {
-    DLOG(INFO) << "parse_list_item_text optional? " << optional;
-    unique_ptr<cst_node> ret = make_unique<cst_list_item_text>();
-
-    switch (lookahead()) {
-        case token_enum::WORD:
-            ret->add_child(parse_text());
-            ret->add_child(parse_list_item_text(true));
-            break;
-
-        case token_enum::IMAGE:
-            ret->add_child(parse_image());
-            ret->add_child(parse_list_item_text(true));
-            break;
+void parser::parse_ordered_list_item() {
+    QAC_TRACE(PARSER, RULE) << "parse_ordered_list_item";
+    open_node(cst_node_enum::ORDERED_LIST_ITEM);
 
-        case token_enum::LATEX_OPENING:
-        case token_enum::LATEX_CENTERED_OPENING:
-            ret->add_child(parse_latex());
-            ret->add_child(parse_list_item_text(true));
-            break;
+    match(token_enum::ORDERED_LIST_ITEM);
+    parse_list_item_text();
 
-        case token_enum::BOLD_OPENING:
-            ret->add_child(parse_bold());
-            ret->add_child(parse_list_item_text(true));
-            break;
-
-        case token_enum::UNDERLINE_OPENING:
-            ret->add_child(parse_underlined());
-            ret->add_child(parse_list_item_text(true));
-            break;
+    close_node();
+}
 
-        case token_enum::CODE_OPENING:
-            ret->add_child(parse_code());
-            ret->add_child(parse_list_item_text(true));
-            break;
+void parser::parse_list_item_text() {
+    QAC_TRACE(PARSER, RULE) << "parse_list_item_text";
+    open_node(cst_node_enum::LIST_ITEM_TEXT);
 
-        case token_enum::TABLE_DIVIDER:
-            ret->add_child(parse_table());
-            ret->add_child(parse_list_item_text(true));
-            break;
+    parse_elements(LIST_ITEM_TEXT_FIRST);
 
-        default:
-            if (!optional) {
-                no_rule_found(cst_node_enum::LIST_ITEM_TEXT);
-                return nullptr;
-            }
-            break;
+    if (child_counts_.back() == 0) {
+        no_rule_found(cst_node_enum::LIST_ITEM_TEXT);
     }
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_bold() {
-    DLOG(INFO) << "parse_bold";
-    unique_ptr<cst_node> ret = make_unique<cst_bold>();
+void parser::parse_bold() {
+    QAC_TRACE(PARSER, RULE) << "parse_bold";
+    open_node(cst_node_enum::BOLD);
 
     match(token_enum::BOLD_OPENING);
-    ret->add_child(parse_text());
+    parse_text();
     match(token_enum::BOLD_CLOSING);
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_underlined() {
-    DLOG(INFO) << "parse_underlined";
-    unique_ptr<cst_node> ret = make_unique<cst_underlined>();
+void parser::parse_underlined() {
+    QAC_TRACE(PARSER, RULE) << "parse_underlined";
+    open_node(cst_node_enum::UNDERLINED);
 
     match(token_enum::UNDERLINE_OPENING);
-    ret->add_child(parse_text());
+    parse_text();
     match(token_enum::UNDERLINE_CLOSING);
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_code() {
-    DLOG(INFO) << "parse_code";
-    unique_ptr<cst_node> ret = make_unique<cst_code>();
+void parser::parse_code() {
+    QAC_TRACE(PARSER, RULE) << "parse_code";
+    open_node(cst_node_enum::CODE);
 
     match(token_enum::CODE_OPENING);
-    ret->add_child(parse_text());
+    parse_text();
     match(token_enum::CODE_CLOSING);
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_chapter(bool optional) {
-    DLOG(INFO) << "parse_chapter optional? " << optional;
-    unique_ptr<cst_node> ret = make_unique<cst_chapter>();
+// The heading token and its caption.
+void parser::parse_heading(token_enum heading) {
+    recoverable([&] {
+        if (parts_) {
+            append_part(heading);
+        } else {
+            match(heading);
+            parse_text();
+            expect_heading();
+        }
+    });
+}
+
+void parser::parse_chapter() {
+    QAC_TRACE(PARSER, RULE) << "parse_chapter";
+    open_node(cst_node_enum::CHAPTER);
 
-    if (lookahead() == token_enum::CHAPTER) {
-        match(token_enum::CHAPTER);
-        ret->add_child(parse_text());
-        ret->add_child(parse_question(true));
-        ret->add_child(parse_section(true));
-        ret->add_child(parse_chapter(true));
-    } else if (!optional) {
-        no_rule_found(cst_node_enum::CHAPTER);
+    parse_heading(token_enum::CHAPTER);
+    parse_questions();
+    while (lookahead() == token_enum::SECTION) {
+        parse_section();
     }
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_section(bool optional) {
-    DLOG(INFO) << "parse_section optional? " << optional;
-    unique_ptr<cst_node> ret = make_unique<cst_section>();
+void parser::parse_section() {
+    QAC_TRACE(PARSER, RULE) << "parse_section";
+    open_node(cst_node_enum::SECTION);
 
-    if (lookahead() == token_enum::SECTION) {
-        match(token_enum::SECTION);
-        ret->add_child(parse_text());
-        ret->add_child(parse_question(true));
-        ret->add_child(parse_subsection(true));
-        ret->add_child(parse_section(true));
-    } else if (!optional) {
-        no_rule_found(cst_node_enum::SECTION);
+    parse_heading(token_enum::SECTION);
+    parse_questions();
+    while (lookahead() == token_enum::SUBSECTION) {
+        parse_subsection();
     }
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_subsection(bool optional) {
-    DLOG(INFO) << "parse_subsection optional? " << optional;
-    unique_ptr<cst_node> ret = make_unique<cst_subsection>();
+void parser::parse_subsection() {
+    QAC_TRACE(PARSER, RULE) << "parse_subsection";
+    open_node(cst_node_enum::SUBSECTION);
 
-    if (lookahead() == token_enum::SUBSECTION) {
-        match(token_enum::SUBSECTION);
-        ret->add_child(parse_text());
-        ret->add_child(parse_question(true));
-        ret->add_child(parse_subsection(true));
-    } else if (!optional) {
-        no_rule_found(cst_node_enum::SUBSECTION);
-    }
+    parse_heading(token_enum::SUBSECTION);
+    parse_questions();
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_table() {
-    DLOG(INFO) << "parse_table";
-    unique_ptr<cst_node> ret = make_unique<cst_table>();
+void parser::parse_table() {
+    QAC_TRACE(PARSER, RULE) << "parse_table";
+    open_node(cst_node_enum::TABLE);
 
     match(token_enum::TABLE_DIVIDER);
-    ret->add_child(parse_table_row());
+    do {
+        parse_table_row();
+    } while (TABLE_CELLS.contains(lookahead()));
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_table_row(bool optional) {
-    DLOG(INFO) << "parse_table_row optional? " << optional;
-    unique_ptr<cst_node> ret = make_unique<cst_table_row>();
+void parser::parse_table_row() {
+    QAC_TRACE(PARSER, RULE) << "parse_table_row";
+    open_node(cst_node_enum::TABLE_ROW);
 
-    switch (lookahead()) {
-        case token_enum::TABLE_CELL:
-        case token_enum::TABLE_CELL_LEFT_ALIGNED:
-        case token_enum::TABLE_CELL_RIGHT_ALIGNED:
-        case token_enum::TABLE_CELL_CENTER_ALIGNED:
-            ret->add_child(parse_table_cell());
-            match(token_enum::TABLE_DIVIDER);
-            ret->add_child(parse_table_row(true));
-            break;
+    if (!TABLE_CELLS.contains(lookahead())) {
+        no_rule_found(cst_node_enum::TABLE_ROW);
+    }
 
-        default:
-            if (!optional) {
-                no_rule_found(cst_node_enum::TABLE_ROW);
-                return nullptr;
-            }
-            break;
+    // the cell token in front of the new line closes the row, it has no text
+    while (parse_table_cell() && TABLE_CELLS.contains(lookahead())) {
     }
+    match(token_enum::TABLE_DIVIDER);
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_table_cell(bool optional) {
-    DLOG(INFO) << "parse_table_cell optional? " << optional;
-    unique_ptr<cst_node> ret = make_unique<cst_table_cell>();
-
-    auto parse_text_and_cell = [&]() {
-        if (lookahead_->get_token() != token_enum::NEW_LINE) {
-            ret->add_child(parse_table_cell_text());
-            ret->add_child(parse_table_cell(true));
-        } else {
-            skip_whitespace();
-        }
-    };
+// Returns false for the cell closing a row, it has no text.
+bool parser::parse_table_cell() {
+    QAC_TRACE(PARSER, RULE) << "parse_table_cell";
+    open_node(cst_node_enum::TABLE_CELL);
 
     switch (lookahead()) {
         case token_enum::TABLE_CELL:
             match(token_enum::TABLE_CELL);
-            parse_text_and_cell();
             break;
 
         case token_enum::TABLE_CELL_LEFT_ALIGNED:
             match(token_enum::TABLE_CELL_LEFT_ALIGNED);
-            dynamic_cast<cst_table_cell *>(ret.get())
-                ->alignment(cst_table_cell::alignment_enum::LEFT);
-            parse_text_and_cell();
+            builder_->set_alignment(cst_alignment_enum::LEFT);
             break;
 
         case token_enum::TABLE_CELL_RIGHT_ALIGNED:
             match(token_enum::TABLE_CELL_RIGHT_ALIGNED);
-            dynamic_cast<cst_table_cell *>(ret.get())
-                ->alignment(cst_table_cell::alignment_enum::RIGHT);
-            parse_text_and_cell();
+            builder_->set_alignment(cst_alignment_enum::RIGHT);
             break;
 
         case token_enum::TABLE_CELL_CENTER_ALIGNED:
             match(token_enum::TABLE_CELL_CENTER_ALIGNED);
-            dynamic_cast<cst_table_cell *>(ret.get())
-                ->alignment(cst_table_cell::alignment_enum::CENTER);
-            parse_text_and_cell();
+            builder_->set_alignment(cst_alignment_enum::CENTER);
             break;
 
         default:
-            if (!optional) {
-                no_rule_found(cst_node_enum::TABLE_CELL);
-                return nullptr;
-            }
+            no_rule_found(cst_node_enum::TABLE_CELL);
             break;
     }
 
-    return ret;
-}
-
-std::unique_ptr<cst_node> parser::parse_table_cell_text() {
-    DLOG(INFO) << "parse_table_cell_text";
-    unique_ptr<cst_node> ret = make_unique<cst_table_cell_text>();
-
-    switch (lookahead()) {
-        case token_enum::WORD:
-            ret->add_child(parse_text());
-            ret->add_child(parse_table_cell_text());
-            break;
-
-        case token_enum::IMAGE:
-            ret->add_child(parse_image());
-            ret->add_child(parse_table_cell_text());
-            break;
-
-        case token_enum::LATEX_OPENING:
-        case token_enum::LATEX_CENTERED_OPENING:
-            ret->add_child(parse_latex());
-            ret->add_child(parse_table_cell_text());
-            break;
-
-        case token_enum::UNORDERED_LIST_ITEM:
-            ret->add_child(parse_unordered_list());
-            ret->add_child(parse_table_cell_text());
-            break;
-
-        case token_enum::ORDERED_LIST_ITEM:
-            ret->add_child(parse_ordered_list());
-            ret->add_child(parse_table_cell_text());
-            break;
-
-        case token_enum::BOLD_OPENING:
-            ret->add_child(parse_bold());
-            ret->add_child(parse_table_cell_text());
-            break;
+    bool has_text = !tokens_->peek().is(token_enum::NEW_LINE);
+    if (has_text) {
+        parse_table_cell_text();
+    } else {
+        skip_whitespace();
+    }
 
-        case token_enum::UNDERLINE_OPENING:
-            ret->add_child(parse_underlined());
-            ret->add_child(parse_table_cell_text());
-            break;
+    close_node();
+    return has_text;
+}
 
-        case token_enum::CODE_OPENING:
-            ret->add_child(parse_code());
-            ret->add_child(parse_table_cell_text());
-            break;
+void parser::parse_table_cell_text() {
+    QAC_TRACE(PARSER, RULE) << "parse_table_cell_text";
+    open_node(cst_node_enum::TABLE_CELL_TEXT);
 
-        default:  // table cells can be empty
-            break;
-    }
+    parse_elements(TABLE_CELL_TEXT_FIRST);
 
-    return ret;
+    close_node();
 }
 
-std::unique_ptr<cst_node> parser::parse_image() {
+void parser::parse_image() {
     match(token_enum::IMAGE);
+    open_node(cst_node_enum::IMAGE);
 
-    unique_ptr<cst_node> ret = make_unique<cst_image>();
+    std::string_view image_keyword = current_.get_value();
 
-    cst_image *pimage = dynamic_cast<cst_image *>(ret.get());
+    // strip leading IMG(, strip trailing ), divide into parts
+    std::string_view content =
+        image_keyword.substr(4, image_keyword.find(')') - 4);
+    std::string_view parts[3];
+    size_t nr_parts = 0;
+    for (size_t start = 0; start != std::string_view::npos; ++nr_parts) {
+        size_t comma = content.find(',', start);
+        if (nr_parts < 3) {
+            parts[nr_parts] = content.substr(start, comma - start);
+        }
+        start = comma == std::string_view::npos ? comma : comma + 1;
+    }
 
-    std::string image_keyword = current_->get_value();
+    auto to_int = [](std::string_view part) {
+        return std::stoi(std::string(part));
+    };
+    if (nr_parts == 3) {
+        builder_->add_word(parts[0]);
+        builder_->set_image(to_int(parts[1]), to_int(parts[2]));
+    } else if (nr_parts == 2) {
+        int wh = to_int(parts[1]);
+        builder_->add_word(parts[0]);
+        builder_->set_image(wh, wh);
+    } else if (nr_parts == 1) {
+        builder_->add_word(parts[0]);
+    }
 
-    // strip leading IMG(, strip trailing ), divide into parts
-    std::vector<std::string> parts;
-    std::string content = image_keyword.substr(4, image_keyword.find(')') - 4);
-    boost::split(parts, content, boost::is_any_of(","));
-    if (parts.size() == 3) {
-        pimage->set_source(parts[0], std::stoi(parts[1]), std::stoi(parts[2]));
-    } else if (parts.size() == 2) {
-        int wh = std::stoi(parts[1]);
-        pimage->set_source(parts[0], wh, wh);
-    } else if (parts.size() == 1) {
-        pimage->set_source(parts[0]);
-    }
-
-    return ret;
+    close_node();
 }
 
 std::string qac::to_string(const cst_node_enum &nenum) {
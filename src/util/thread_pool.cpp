@@ -0,0 +1,45 @@
+#include "qac/util/thread_pool.h"
+
+#include <algorithm>
+
+using namespace qac;
+using namespace std;
+
+thread_pool::thread_pool(unsigned threads) {
+    if (threads == 0) {
+        threads = max(thread::hardware_concurrency(), 1u);
+    }
+
+    for (unsigned i = 0; i < threads; ++i) {
+        workers_.emplace_back(&thread_pool::work, this);
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    condition_.notify_all();
+
+    for (thread &worker : workers_) {
+        worker.join();
+    }
+}
+
+void thread_pool::work() {
+    for (;;) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(mutex_);
+            condition_.wait(lock,
+                            [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,82 @@
+#include <qac/util/trace.h>
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace qac;
+using namespace std;
+
+namespace {
+
+const char *to_string(trace_component component) {
+    switch (component) {
+        case trace_component::LEXER:
+            return "lexer";
+        case trace_component::PARSER:
+            return "parser";
+        case trace_component::VISITOR:
+            return "visitor";
+    }
+    return "";
+}
+}
+
+trace_buffer &trace_buffer::instance() {
+    static trace_buffer buffer;
+    return buffer;
+}
+
+void trace_buffer::enable(const string &components) {
+    uint32_t mask = 0;
+
+    istringstream names(components);
+    for (string name; getline(names, name, ',');) {
+        if (name == "all") {
+            mask = ~0u;
+        } else if (name == "lexer") {
+            mask |= bit(trace_component::LEXER);
+        } else if (name == "parser") {
+            mask |= bit(trace_component::PARSER);
+        } else if (name == "visitor") {
+            mask |= bit(trace_component::VISITOR);
+        } else if (!name.empty()) {
+            throw runtime_error("Unknown trace component '" + name + "'");
+        }
+    }
+
+    mask_.store(mask, memory_order_relaxed);
+}
+
+void trace_buffer::set_capacity(size_t capacity) {
+    lock_guard<mutex> lock(mutex_);
+    capacity_ = capacity ? capacity : 1;
+    entries_.clear();
+    next_ = 0;
+}
+
+void trace_buffer::record(trace_component component, string message) {
+    lock_guard<mutex> lock(mutex_);
+    if (entries_.size() < capacity_) {
+        entries_.push_back({component, std::move(message)});
+    } else {
+        entries_[next_] = {component, std::move(message)};
+    }
+    next_ = (next_ + 1) % capacity_;
+}
+
+void trace_buffer::clear() {
+    lock_guard<mutex> lock(mutex_);
+    entries_.clear();
+    next_ = 0;
+}
+
+void trace_buffer::dump(ostream &os) {
+    lock_guard<mutex> lock(mutex_);
+
+    // once the buffer is full, next_ points at the oldest message
+    size_t first = entries_.size() < capacity_ ? 0 : next_;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        const entry &e = entries_[(first + i) % entries_.size()];
+        os << to_string(e.component) << ": " << e.message << "\n";
+    }
+}
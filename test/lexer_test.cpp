@@ -1,7 +1,16 @@
 #include "catch.hpp"
+#include "qac/lexer/delimiter_scanner.h"
 #include "qac/lexer/lexer.h"
+#include "qac/lexer/symbol_table.h"
+#include "qac/lexer/token_cache.h"
+#include "qac/lexer/token_stream.h"
 
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
 #include <sstream>
+#include <string>
 #include <vector>
 
 using namespace qac;
@@ -30,3 +39,393 @@ TEST_CASE("lexer test", "[lexer]") {
         REQUIRE(expected == actual);
     }
 }
+
+TEST_CASE("lexer buffer input", "[lexer]") {
+    SECTION("buffer and stream input yield the same tokens") {
+        std::string input =
+            "CHA: Chapter\n"
+            "\n"
+            "Q: What is *bold*, \\(a+b\\)?\n"
+            "# comment\n"
+            "A:  - one\n"
+            "    - two";
+
+        std::stringstream ss(input);
+        lexer stream_lexer;
+        std::vector<token> expected = stream_lexer.lex(ss);
+
+        lexer buffer_lexer;
+        std::vector<token> actual =
+            buffer_lexer.lex(input.data(), input.size());
+
+        REQUIRE(expected.size() == actual.size());
+        REQUIRE(expected == actual);
+    }
+
+    SECTION("trailing newline does not add a line") {
+        std::string input = "Q: Hello\nA: World\n";
+
+        lexer l;
+        std::vector<token> actual = l.lex(input.data(), input.size());
+
+        REQUIRE(actual.size() == 6);
+        REQUIRE(actual.back() == token(token_enum::NEW_LINE, "", 2));
+    }
+}
+
+TEST_CASE("lexer token spans", "[lexer]") {
+    SECTION("token values point into the source buffer") {
+        std::string input = "Q: What is *bold*?\nA:   \\(x\\)\n";
+
+        lexer l;
+        std::vector<token> tokens = l.lex(input.data(), input.size());
+
+        for (const token& t : tokens) {
+            REQUIRE(t.get_value().data() >= input.data());
+            REQUIRE(t.get_value().data() + t.get_value().size() <=
+                    input.data() + input.size());
+        }
+    }
+
+    SECTION("tokens carry their column") {
+        std::string input = "Q: What is *bold*?\nA:   \\(x\\)\n";
+
+        lexer l;
+        std::vector<token> tokens = l.lex(input.data(), input.size());
+
+        REQUIRE(tokens[0] == token(token_enum::QUESTION, "Q:", 1));
+        REQUIRE(tokens[0].column() == 1);
+        REQUIRE(tokens[3] == token(token_enum::BOLD_OPENING, "*", 1));
+        REQUIRE(tokens[3].column() == 12);
+        REQUIRE(tokens[5] == token(token_enum::BOLD_CLOSING, "*", 1));
+        REQUIRE(tokens[5].column() == 17);
+        REQUIRE(tokens[6] == token(token_enum::WORD, "?", 1));
+        REQUIRE(tokens[6].column() == 18);
+        REQUIRE(tokens[12] == token(token_enum::LATEX_CODE, "x", 2));
+        REQUIRE(tokens[12].column() == 8);
+    }
+}
+
+TEST_CASE("lexer keywords", "[lexer]") {
+    // tokens point into the input, so it has to stay alive
+    std::string input;
+    lexer l;
+    auto lex = [&](const std::string& text) {
+        input = text;
+        return l.lex(input.data(), input.size());
+    };
+
+    SECTION("keywords are only recognized as the first word") {
+        std::vector<token> actual = lex("- Q: - 12. IMG(a.png,1)");
+
+        std::vector<token> expected = {
+            token(token_enum::UNORDERED_LIST_ITEM, "-", 1),
+            token(token_enum::WORD, "Q:", 1),
+            token(token_enum::WORD, "-", 1),
+            token(token_enum::WORD, "12.", 1),
+            token(token_enum::IMAGE, "IMG(a.png,1)", 1),
+            token(token_enum::NEW_LINE, "", 1),
+        };
+
+        REQUIRE(expected == actual);
+    }
+
+    SECTION("table cells and dividers") {
+        std::vector<token> actual = lex("------\n|< a |- b |> c | d |--");
+
+        std::vector<token> expected = {
+            token(token_enum::TABLE_DIVIDER, "------", 1),
+            token(token_enum::NEW_LINE, "", 1),
+            token(token_enum::TABLE_CELL_LEFT_ALIGNED, "|<", 2),
+            token(token_enum::WORD, "a", 2),
+            token(token_enum::TABLE_CELL_CENTER_ALIGNED, "|-", 2),
+            token(token_enum::WORD, "b", 2),
+            token(token_enum::TABLE_CELL_RIGHT_ALIGNED, "|>", 2),
+            token(token_enum::WORD, "c", 2),
+            token(token_enum::TABLE_CELL, "|", 2),
+            token(token_enum::WORD, "d", 2),
+            token(token_enum::WORD, "|--", 2),
+            token(token_enum::NEW_LINE, "", 2),
+        };
+
+        REQUIRE(expected == actual);
+    }
+
+    SECTION("delimiters open before keywords are checked") {
+        std::vector<token> actual = lex("*Q:* IMG(x \\[a\\].");
+
+        std::vector<token> expected = {
+            token(token_enum::BOLD_OPENING, "*", 1),
+            token(token_enum::WORD, "Q:", 1),
+            token(token_enum::BOLD_CLOSING, "*", 1),
+            token(token_enum::WORD, "IMG(x", 1),
+            token(token_enum::LATEX_CENTERED_OPENING, "\\[", 1),
+            token(token_enum::LATEX_CODE, "a", 1),
+            token(token_enum::LATEX_CENTERED_CLOSING, "\\]", 1),
+            token(token_enum::WORD, ".", 1),
+            token(token_enum::NEW_LINE, "", 1),
+        };
+
+        REQUIRE(expected == actual);
+    }
+}
+
+TEST_CASE("delimiter scanner", "[lexer]") {
+    SECTION("vectorized masks match the scalar masks") {
+        const char alphabet[] = "ab \n*_`\\|#(Q:\x80\xff";
+        std::mt19937 random(42);
+        std::uniform_int_distribution<size_t> pick(0, sizeof(alphabet) - 2);
+
+        for (int i = 0; i < 256; ++i) {
+            char block[delimiter_scanner::BLOCK_SIZE];
+            for (char &c : block) {
+                c = alphabet[pick(random)];
+            }
+
+            block_masks expected, actual;
+            delimiter_scanner::scalar_implementation()(block, expected);
+            delimiter_scanner::best_implementation()(block, actual);
+
+            REQUIRE(expected.newline == actual.newline);
+            REQUIRE(expected.space == actual.space);
+            REQUIRE(expected.markup == actual.markup);
+        }
+    }
+
+    SECTION("lines and words spanning block boundaries") {
+        std::string xs(70, 'x'), zs(130, 'z');
+        std::string input = "Q: " + xs + " *y*\n" + "A: " + zs + " w";
+
+        lexer l;
+        std::vector<token> actual = l.lex(input.data(), input.size());
+
+        std::vector<token> expected = {
+            token(token_enum::QUESTION, "Q:", 1),
+            token(token_enum::WORD, xs, 1),
+            token(token_enum::BOLD_OPENING, "*", 1),
+            token(token_enum::WORD, "y", 1),
+            token(token_enum::BOLD_CLOSING, "*", 1),
+            token(token_enum::NEW_LINE, "", 1),
+            token(token_enum::ANSWER, "A:", 2),
+            token(token_enum::WORD, zs, 2),
+            token(token_enum::WORD, "w", 2),
+            token(token_enum::NEW_LINE, "", 2),
+        };
+
+        REQUIRE(expected == actual);
+    }
+}
+
+TEST_CASE("parallel lexer", "[lexer]") {
+    std::string input;
+    for (int i = 0; i < 8000; ++i) {
+        input += "CHA: Chapter " + std::to_string(i) + "\n\n";
+        input += "Q: What is *bold* and \\(x\\)?\n";
+        input += "A: - a `code`\n";
+        // a blank line inside an open delimiter is no safe chunk start
+        input += "\\[\n\na^2\n\n\\]\n\n";
+    }
+
+    lexer sequential;
+    std::vector<token> expected = sequential.lex(input.data(), input.size());
+
+    for (unsigned threads : {2u, 3u, 7u}) {
+        lexer parallel;
+        parallel.set_threads(threads);
+        std::vector<token> actual = parallel.lex(input.data(), input.size());
+
+        REQUIRE(expected.size() == actual.size());
+        REQUIRE(expected == actual);
+    }
+}
+
+TEST_CASE("lexer includes", "[lexer]") {
+    struct file {
+        const char *name;
+        const char *content;
+    };
+    std::vector<file> files = {
+        {"lexer_test_a.qa", "Q: a\nFILE: lexer_test_b.qa\n"},
+        {"lexer_test_b.qa", "Q: b\nFILE: ./lexer_test_a.qa\n"},
+        {"lexer_test_c.qa", "Q: c\n"},
+    };
+    for (const file &f : files) {
+        std::ofstream(f.name) << f.content;
+    }
+
+    std::string input =
+        "FILE: lexer_test_a.qa\n"
+        "Q: root\n"
+        "FILE: lexer_test_c.qa\n"
+        "FILE: ./lexer_test_b.qa\n"
+        "FILE: lexer_test_c.qa\n";
+
+    lexer l;
+    l.set_threads(3);
+    std::vector<token> actual = l.lex(input.data(), input.size());
+
+    for (const file &f : files) {
+        std::remove(f.name);
+    }
+
+    // every file is included once, at its first include
+    std::vector<token> expected = {
+        token(token_enum::QUESTION, "Q:", 1),
+        token(token_enum::WORD, "a", 1),
+        token(token_enum::NEW_LINE, "", 1),
+        token(token_enum::QUESTION, "Q:", 1),
+        token(token_enum::WORD, "b", 1),
+        token(token_enum::NEW_LINE, "", 1),
+        token(token_enum::QUESTION, "Q:", 2),
+        token(token_enum::WORD, "root", 2),
+        token(token_enum::NEW_LINE, "", 2),
+        token(token_enum::QUESTION, "Q:", 1),
+        token(token_enum::WORD, "c", 1),
+        token(token_enum::NEW_LINE, "", 1),
+    };
+
+    REQUIRE(expected == actual);
+
+    // included tokens know their file
+    std::vector<std::string> names = {"", "lexer_test_a.qa",
+                                      "lexer_test_b.qa", "lexer_test_c.qa"};
+    REQUIRE(l.files() == names);
+    std::vector<uint16_t> file_ids = {1, 1, 1, 2, 2, 2, 0, 0, 0, 3, 3, 3};
+    for (size_t i = 0; i < actual.size(); ++i) {
+        REQUIRE(actual[i].file() == file_ids[i]);
+    }
+}
+
+TEST_CASE("lexer cache", "[lexer]") {
+    std::ofstream("lexer_test_e.qa")
+        << "CHA: e\nQ: *a* \\(x\n\ny\\)\nFILE: lexer_test_f.qa\nA: b\n";
+    std::ofstream("lexer_test_f.qa") << "Q: f\nA: |< g |\n";
+    token_cache cache("lexer_test_cache");
+
+    auto lex = [&](const token_cache *cache) {
+        lexer l;
+        l.set_cache(cache);
+        std::vector<token> tokens = l.lex_file("lexer_test_e.qa");
+        REQUIRE(l.files().size() == 2);
+
+        std::ostringstream oss;
+        for (const token &t : tokens) {
+            oss << t << ":" << t.column() << ":" << t.file() << "\n";
+        }
+        return oss.str();
+    };
+
+    std::string expected = lex(nullptr);
+    REQUIRE(lex(&cache) == expected);
+    auto entries = [] {
+        return std::distance(
+            std::filesystem::directory_iterator("lexer_test_cache"),
+            std::filesystem::directory_iterator());
+    };
+    REQUIRE(entries() == 2);
+
+    // the second time the tokens come from the cache
+    REQUIRE(lex(&cache) == expected);
+    REQUIRE(entries() == 2);
+
+    std::ofstream("lexer_test_f.qa") << "Q: f\nA: changed\n";
+    expected = lex(nullptr);
+    REQUIRE(lex(&cache) == expected);
+    REQUIRE(entries() == 3);
+
+    std::remove("lexer_test_e.qa");
+    std::remove("lexer_test_f.qa");
+    std::filesystem::remove_all("lexer_test_cache");
+}
+
+TEST_CASE("lexer line numbers", "[lexer]") {
+    std::string input(70000, '\n');
+    input += "Q: x";
+
+    lexer l;
+    std::vector<token> tokens = l.lex(input.data(), input.size());
+
+    REQUIRE(tokens.back().line() == 70001);
+    REQUIRE(tokens.back().column() == 5);
+
+    std::istringstream ss(input);
+    token_stream stream(ss);
+    while (!stream.peek().is(token_enum::QUESTION)) {
+        stream.next();
+    }
+    REQUIRE(stream.peek().line() == 70001);
+}
+
+TEST_CASE("token stream", "[lexer]") {
+    std::ofstream("lexer_test_d.qa") << "Q: d \\(x\n\ny\\)\n";
+
+    std::string input =
+        "CHA: c\n"
+        "Q: *a\n"
+        "\n"
+        "b* # no comment\n"
+        "# comment\n"
+        "FILE: lexer_test_d.qa\n"
+        "A: |< x | y\n"
+        "FILE: lexer_test_d.qa\n"
+        "A: IMG(i.png) end";
+
+    lexer l;
+    std::vector<token> expected = l.lex(input.data(), input.size());
+
+    std::istringstream ss(input);
+    token_stream stream(ss);
+    std::vector<token> actual;
+    while (!stream.peek().is(token_enum::END_OF_FILE)) {
+        actual.push_back(stream.next());
+        // the value of the last token has to stay valid
+        REQUIRE(actual.back().get_value() == expected[actual.size() - 1]
+                                                 .get_value());
+    }
+
+    std::remove("lexer_test_d.qa");
+
+    REQUIRE(stream.next().is(token_enum::END_OF_FILE));
+    REQUIRE(expected.size() == actual.size());
+    REQUIRE(expected == actual);
+}
+
+TEST_CASE("token interning", "[lexer]") {
+    std::string input =
+        "Q: the a the \\(\\frac a \\frac\\)\n"
+        "\n"
+        "A: the | a |";
+
+    lexer l;
+    std::vector<token> tokens = l.lex(input.data(), input.size());
+    interned_tokens interned(tokens);
+
+    // distinct values: Q: the a \( \frac \) "" A: |
+    REQUIRE(interned.symbols().size() == 9);
+    REQUIRE(interned.size() == tokens.size());
+
+    std::vector<std::string> values;
+    for (const token &t : tokens) {
+        values.emplace_back(t.get_value());
+    }
+
+    // interned values don't depend on the source any more
+    input.assign(input.size(), '?');
+    for (size_t i = 0; i < interned.size(); ++i) {
+        token t = interned[i];
+        REQUIRE(t.get_token() == tokens[i].get_token());
+        REQUIRE(t.get_value() == values[i]);
+        REQUIRE(t.line() == tokens[i].line());
+    }
+
+    REQUIRE(interned[1].get_value() == "the");
+    REQUIRE(interned[1].get_value().data() == interned[3].get_value().data());
+    REQUIRE(interned[6].get_value() == "a");
+
+    interned_token_source source(interned);
+    size_t count = 0;
+    while (!source.peek().is(token_enum::END_OF_FILE)) {
+        REQUIRE(source.next().get_token() == tokens[count++].get_token());
+    }
+    REQUIRE(count == tokens.size());
+}
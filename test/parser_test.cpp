@@ -1,9 +1,546 @@
 #include "catch.hpp"
+#include "qac/generator/anki-generator.h"
+#include "qac/generator/html-generator.h"
+#include "qac/parser/ast_builder.h"
+#include "qac/parser/document.h"
 #include "qac/parser/parser.h"
 
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
 TEST_CASE( "parser test", "[parser]" ) {
     SECTION( "test 1" ) {
         REQUIRE(true);
     }
 }
 
+
+TEST_CASE("parser error location", "[parser]") {
+    std::string input = "Q: a\nA: b\n\nQ: Q: c";
+
+    qac::lexer lexer;
+    std::vector<qac::token> tokens = lexer.lex(input.data(), input.size());
+
+    std::vector<std::string> files = {"", "deck.qa"};
+    qac::parser parser;
+    parser.set_files(files);
+
+    auto error = [&]() -> std::string {
+        try {
+            parser.parse(tokens);
+        } catch (std::runtime_error &e) {
+            return e.what();
+        }
+        return "";
+    };
+
+    SECTION("the offending token is reported") {
+        REQUIRE(error() ==
+                "Line 4, column 4: Trying to parse QUESTION_TEXT, but found "
+                "no applicable rule.");
+    }
+
+    SECTION("included tokens are reported with their file") {
+        for (qac::token &t : tokens) {
+            t = qac::token(t.get_token(), t.get_value(), t.line(), t.column(),
+                           1);
+        }
+        REQUIRE(error() ==
+                "deck.qa: Line 4, column 4: Trying to parse QUESTION_TEXT, "
+                "but found no applicable rule.");
+    }
+}
+
+TEST_CASE("parser error recovery", "[parser]") {
+    qac::lexer lexer;
+    qac::parser parser;
+
+    auto errors = [&](const std::string &input) {
+        std::vector<qac::token> tokens =
+            lexer.lex(input.data(), input.size());
+        try {
+            parser.parse(tokens);
+        } catch (qac::parse_error &e) {
+            return e.messages();
+        }
+        return std::vector<std::string>();
+    };
+
+    SECTION("all questions are checked") {
+        auto messages = errors(
+            "Q: a\nA: b\n\nQ: Q: c\nA: d\n\nQ: e\n\nQ: f\nA: g\n");
+        REQUIRE(messages.size() == 2);
+        REQUIRE(messages[0] ==
+                "Line 4, column 4: Trying to parse QUESTION_TEXT, but found "
+                "no applicable rule.");
+        REQUIRE(messages[1] ==
+                "Line 9, column 1: Match failed. Expected ANSWER, but got "
+                "QUESTION.");
+    }
+
+    SECTION("headings out of place are reported") {
+        auto messages = errors(
+            "CHA: a\nQ: b\nA: c\nSUB: d\nQ: e\nA: f\nCHA:\nQ: g\nA: h\n");
+        REQUIRE(messages.size() == 2);
+        REQUIRE(messages[0] ==
+                "Line 4, column 1: Trying to parse ROOT, but found no "
+                "applicable rule.");
+        REQUIRE(messages[1] ==
+                "Line 7, column 5: Match failed. Expected WORD, but got "
+                "NEW_LINE.");
+    }
+
+    SECTION("text after a caption doesn't move the questions out") {
+        auto messages = errors("CHA: a *b*\nQ: c\nA: d\n\nQ: e\nA: f\n");
+        REQUIRE(messages.size() == 1);
+        REQUIRE(messages[0] ==
+                "Line 1, column 8: Trying to parse ROOT, but found no "
+                "applicable rule.");
+    }
+
+    SECTION("a deck without errors") {
+        REQUIRE(errors("CHA: a\nSEC: b\nSUB: c\nQ: d\nA: e\n").empty());
+    }
+}
+
+TEST_CASE("parser repetitions", "[parser]") {
+    qac::lexer lexer;
+    qac::parser parser;
+
+    SECTION("questions are siblings") {
+        std::string input;
+        for (int i = 0; i < 100000; ++i) {
+            input += "Q: q" + std::to_string(i) + "\nA: a\n\n";
+        }
+
+        std::vector<qac::token> tokens = lexer.lex(input.data(), input.size());
+        qac::cst tree = parser.parse(tokens);
+        qac::cst_node root = tree.root();
+
+        REQUIRE(root.children().size() == 100000);
+        REQUIRE(root.children().back().type() ==
+                qac::cst_node_enum::QUESTION);
+        REQUIRE(root.children().back().children().size() == 2);
+    }
+
+    SECTION("chapters, sections, list items and table rows are siblings") {
+        std::string input =
+            "CHA: c1\n\nQ: q\nA: - a\n   - b\n   - c\n\n"
+            "SEC: s1\n\nQ: q\nA: x\n   ---\n   |< a |- b |\n   ---\n"
+            "   | c | d |\n   ---\n"
+            "\nSEC: s2\n\nCHA: c2\n\nQ: q\nA: a\n";
+
+        std::vector<qac::token> tokens = lexer.lex(input.data(), input.size());
+        qac::cst tree = parser.parse(tokens);
+        qac::cst_node root = tree.root();
+        const auto &chapters = root.children();
+        REQUIRE(chapters.size() == 2);
+
+        // caption, question, two sections
+        const auto &chapter = chapters[0].children();
+        REQUIRE(chapter.size() == 4);
+        REQUIRE(chapter[3].type() == qac::cst_node_enum::SECTION);
+
+        const auto &answer = chapter[1].children()[1].children();
+        REQUIRE(answer.size() == 1);
+        REQUIRE(answer[0].children().size() == 3);
+
+        // text and table; two rows of two cells and the closing cell
+        const auto &table =
+            chapter[2].children()[1].children()[1].children()[1];
+        REQUIRE(table.type() == qac::cst_node_enum::TABLE);
+        REQUIRE(table.children().size() == 2);
+        REQUIRE(table.children()[1].children().size() == 3);
+        REQUIRE(chapters[1].children().size() == 2);
+    }
+}
+
+TEST_CASE("parser arena", "[parser]") {
+    std::string input =
+        "Q: two words IMG(a.png,10,20)\nA: x\n   ---\n   |> y |\n   ---\n";
+
+    qac::lexer lexer;
+    std::vector<qac::token> tokens = lexer.lex(input.data(), input.size());
+    qac::parser parser;
+    qac::cst tree = parser.parse(tokens);
+
+    // root, question, question text, text, image, answer text, text, table,
+    // row, two cells, cell text, text
+    REQUIRE(tree.size() == 13);
+
+    qac::cst_node question = tree.root().children()[0];
+    const auto &question_text = question.children()[0].children();
+    REQUIRE(qac::cst_text(tree, question_text[0].index()).words() ==
+            "two words");
+
+    qac::cst_image image(tree, question_text[1].index());
+    REQUIRE(image.get_source() == "a.png");
+    REQUIRE(image.get_width() == 10);
+    REQUIRE(image.get_height() == 20);
+
+    qac::cst_node row =
+        question.children()[1].children()[1].children()[0];
+    REQUIRE(qac::cst_table_cell(tree, row.children()[0].index()).alignment() ==
+            qac::cst_alignment_enum::RIGHT);
+}
+
+TEST_CASE("parser images", "[parser]") {
+    std::string input = "Q: IMG(a.png) IMG(b.png,5) IMG(c.png,6,7)\nA: x";
+
+    qac::lexer lexer;
+    std::vector<qac::token> tokens = lexer.lex(input.data(), input.size());
+    qac::parser parser;
+    qac::cst tree = parser.parse(tokens);
+
+    const auto &question_text =
+        tree.root().children()[0].children()[0].children();
+    REQUIRE(question_text.size() == 3);
+
+    auto image = [&](size_t nth) {
+        return qac::cst_image(tree, question_text[nth].index());
+    };
+    REQUIRE(image(0).get_source() == "a.png");
+    REQUIRE(image(0).get_width() == -1);
+    REQUIRE(image(1).get_source() == "b.png");
+    REQUIRE(image(1).get_height() == 5);
+    REQUIRE(image(2).get_source() == "c.png");
+    REQUIRE(image(2).get_width() == 6);
+    REQUIRE(image(2).get_height() == 7);
+}
+
+namespace {
+
+// Writes the events down in a compact form.
+class event_recorder : public qac::parse_handler {
+   public:
+    std::string events;
+
+    void on_document_begin() override { events += "doc("; }
+    void on_document_end() override { events += ")"; }
+    void on_chapter_begin(std::string_view caption) override {
+        events += "cha[" + std::string(caption) + "](";
+    }
+    void on_chapter_end() override { events += ")"; }
+    void on_question_begin() override { events += "q("; }
+    void on_question_end() override { events += ")"; }
+    void on_answer_text_begin() override { events += "|"; }
+    void on_text(std::string_view words) override {
+        events += "t[" + std::string(words) + "]";
+    }
+    void on_image(std::string_view source, int width, int height) override {
+        events += "img[" + std::string(source) + "," +
+                  std::to_string(width) + "," + std::to_string(height) + "]";
+    }
+    void on_latex(std::string_view body, bool centered) override {
+        events += (centered ? "clatex[" : "latex[") + std::string(body) + "]";
+    }
+    void on_bold(std::string_view words) override {
+        events += "b[" + std::string(words) + "]";
+    }
+    void on_unordered_list_begin() override { events += "ul("; }
+    void on_unordered_list_end() override { events += ")"; }
+    void on_list_item_begin() override { events += "li("; }
+    void on_list_item_end() override { events += ")"; }
+    void on_table_begin() override { events += "table("; }
+    void on_table_end() override { events += ")"; }
+    void on_table_row_begin() override { events += "tr("; }
+    void on_table_row_end() override { events += ")"; }
+    void on_table_cell_begin(qac::cst_alignment_enum alignment) override {
+        events += alignment == qac::cst_alignment_enum::RIGHT ? "td>(" : "td(";
+    }
+    void on_table_cell_end() override { events += ")"; }
+};
+}
+
+TEST_CASE("parser events", "[parser]") {
+    std::string input =
+        "CHA: one\n\nQ: a *b* IMG(c.png,5)\nA: \\(x\\)\n   - d\n   - e\n\n"
+        "Q: f\nA: ---\n   | g |> h |\n   ---\n";
+
+    qac::lexer lexer;
+    std::vector<qac::token> tokens = lexer.lex(input.data(), input.size());
+    qac::parser parser;
+    const std::string expected =
+        "doc(cha[one](q(t[a]b[b]img[c.png,5,5]|latex[x]ul(li(t[d])li(t[e])))"
+        "q(t[f]|table(tr(td(t[g])td>(t[h]))))))";
+
+    SECTION("the parser calls the handler") {
+        event_recorder recorder;
+        parser.parse(tokens, recorder);
+        REQUIRE(recorder.events == expected);
+    }
+
+    SECTION("a replayed tree gives the same events") {
+        qac::cst tree = parser.parse(tokens);
+        event_recorder recorder;
+        qac::parse_event_builder events(recorder);
+        tree.replay(events);
+        REQUIRE(recorder.events == expected);
+    }
+}
+
+TEST_CASE("parser chapters in parallel", "[parser]") {
+    qac::lexer lexer;
+
+    std::string input;
+    for (int i = 0; i < 20; ++i) {
+        std::string n = std::to_string(i);
+        input += "CHA: c" + n + "\n\nQ: a *b* " + n + "\nA: - c\n   - d\n\n" +
+                 "SEC: s" + n + "\nQ: e\nA: f\n\nSUB: u" + n + "\n\nQ: g\nA: h\n";
+    }
+    std::vector<qac::token> tokens = lexer.lex(input.data(), input.size());
+
+    auto events = [&](unsigned threads) {
+        qac::parser parser;
+        parser.set_threads(threads);
+        qac::cst tree = parser.parse(tokens);
+
+        event_recorder recorder;
+        qac::parse_event_builder builder(recorder);
+        tree.replay(builder);
+        return recorder.events;
+    };
+
+    SECTION("the tree is the same as with one thread") {
+        std::string serial = events(1);
+        REQUIRE(serial.find("cha[c19]") != std::string::npos);
+        REQUIRE(events(4) == serial);
+    }
+
+    SECTION("the errors are the same as with one thread") {
+        input += "CHA: x\nQ: no answer\nCHA: y\nQ: Q: z\nA: w\nCHA:\n";
+        tokens = lexer.lex(input.data(), input.size());
+
+        auto errors = [&](unsigned threads) {
+            qac::parser parser;
+            parser.set_threads(threads);
+            try {
+                parser.parse(tokens);
+            } catch (qac::parse_error &e) {
+                return e.messages();
+            }
+            return std::vector<std::string>();
+        };
+
+        std::vector<std::string> serial = errors(1);
+        REQUIRE(serial.size() == 3);
+        REQUIRE(errors(4) == serial);
+    }
+}
+
+TEST_CASE("parser document", "[parser]") {
+    // the events of the tree, or the errors
+    auto result = [](auto parse) {
+        std::string events;
+        try {
+            qac::cst tree = parse();
+            event_recorder recorder;
+            qac::parse_event_builder builder(recorder);
+            tree.replay(builder);
+            events = recorder.events;
+        } catch (qac::parse_error &e) {
+            for (const std::string &message : e.messages()) {
+                events += message + "\n";
+            }
+        }
+        return events;
+    };
+
+    auto full_parse = [&](const std::string &text) {
+        return result([&] {
+            qac::lexer lexer;
+            std::vector<qac::token> tokens =
+                lexer.lex(text.data(), text.size());
+            return qac::parser().parse(tokens);
+        });
+    };
+
+    std::string input;
+    for (int i = 0; i < 10; ++i) {
+        std::string n = std::to_string(i);
+        input += "CHA: c" + n + "\n\nQ: a " + n + "\nA: - b\n   - c\n\n" +
+                 "SEC: s" + n + "\nQ: d\nA: e\n";
+    }
+    qac::document doc(input);
+    REQUIRE(doc.text() == input);
+    REQUIRE(doc.parts() == 41);
+    REQUIRE(result([&] { return doc.tree(); }) == full_parse(input));
+
+    auto edit = [&](const std::string &what, const std::string &with) {
+        size_t offset = doc.text().find(what);
+        REQUIRE(offset != std::string::npos);
+        doc.edit(offset, what.size(), with);
+        REQUIRE(result([&] { return doc.tree(); }) == full_parse(doc.text()));
+    };
+
+    SECTION("an edit parses the question again") {
+        edit("a 5", "a *five*");
+        REQUIRE(doc.reparsed() == 2);
+        REQUIRE(doc.text().find("Q: a *five*\n") != std::string::npos);
+    }
+
+    SECTION("edits can join and split parts") {
+        edit("\nSEC: s3", "\nSEC s3");
+        REQUIRE(doc.parts() == 40);
+        edit("Q: d\nA: e\nCHA: c7", "Q: d\nA: e\nQ: x\nA: y\n\nCHA: c7");
+        REQUIRE(doc.parts() == 41);
+        edit("CHA: c0", "junk\nCHA: c0");
+        edit("junk\n", "");
+        REQUIRE(doc.parts() == 41);
+    }
+
+    SECTION("an open delimiter reaches into the next parts") {
+        edit("A: e\nCHA: c4", "A: \\[ e\nCHA: c4");
+        edit("Q: a 6", "Q: a 6 \\]");
+    }
+
+    SECTION("errors move with their lines") {
+        edit("Q: d\nA: e\nCHA: c9", "Q: d\nCHA: c9");
+        std::string errors = result([&] { return doc.tree(); });
+        REQUIRE(errors.find("Line 81, column 1: Match failed") != std::string::npos);
+        edit("CHA: c1\n", "CHA: c1\n\n\n");
+        REQUIRE(result([&] { return doc.tree(); }).find("Line 83, column 1: Match failed") !=
+                std::string::npos);
+        edit("Q: d\nCHA: c9", "Q: d\nA: e\nCHA: c9");
+    }
+
+    SECTION("all text can be replaced") {
+        edit(input, "");
+        REQUIRE(doc.parts() == 1);
+        edit("", "Q: a\nA: b\n");
+        REQUIRE(doc.parts() == 2);
+    }
+
+    SECTION("an edit out of range is rejected") {
+        bool thrown = false;
+        try {
+            doc.edit(input.size(), 1, "x");
+        } catch (std::runtime_error &) {
+            thrown = true;
+        }
+        REQUIRE(thrown);
+    }
+}
+
+TEST_CASE("parser ast texts", "[parser]") {
+    std::string input =
+        "Q: What is *bold*?\n"
+        "A: ---\n"
+        "   |< a | b |\n"
+        "   ---\n"
+        "   - one \\(x\\)\n"
+        "   - two\n";
+
+    qac::lexer lexer;
+    std::vector<qac::token> tokens = lexer.lex(input.data(), input.size());
+    qac::parser parser;
+    qac::cst tree = parser.parse(tokens);
+
+    qac::ast_builder builder;
+    qac::parse_event_builder events(builder);
+    tree.replay(events);
+    qac::ast_node::ptr root = builder.root();
+
+    const auto &questions =
+        static_cast<const qac::ast_root_questions &>(*root).questions();
+    REQUIRE(questions.size() == 1);
+
+    auto types = [](const qac::ast_text &text) {
+        std::vector<qac::ast_text_enum> types;
+        for (const auto &element : text.elements()) {
+            types.push_back(element.type);
+        }
+        return types;
+    };
+
+    SECTION("the texts don't depend on a generator") {
+        using qac::ast_text_enum;
+        const qac::ast_text &question = questions[0]->question();
+        std::vector<ast_text_enum> question_types = {
+            ast_text_enum::TEXT, ast_text_enum::BOLD, ast_text_enum::TEXT};
+        REQUIRE(types(question) == question_types);
+        REQUIRE(question.words(question.elements()[1]) == "bold");
+
+        const qac::ast_text &answer = questions[0]->answer();
+        std::vector<ast_text_enum> answer_types = {
+            ast_text_enum::TABLE,          ast_text_enum::TABLE_ROW,
+            ast_text_enum::TABLE_CELL,     ast_text_enum::TEXT,
+            ast_text_enum::END,            ast_text_enum::TABLE_CELL,
+            ast_text_enum::TEXT,           ast_text_enum::END,
+            ast_text_enum::END,            ast_text_enum::END,
+            ast_text_enum::UNORDERED_LIST, ast_text_enum::LIST_ITEM,
+            ast_text_enum::TEXT,           ast_text_enum::LATEX,
+            ast_text_enum::END,            ast_text_enum::LIST_ITEM,
+            ast_text_enum::TEXT,           ast_text_enum::END,
+            ast_text_enum::END};
+        REQUIRE(types(answer) == answer_types);
+        REQUIRE(answer.elements()[2].alignment ==
+                qac::cst_alignment_enum::LEFT);
+    }
+
+    SECTION("one tree is rendered by every generator") {
+        qac::html_generator html;
+        qac::anki_generator anki;
+        for (qac::generator *generator :
+             std::vector<qac::generator *>{&html, &anki}) {
+            std::ostringstream generated;
+            generator->generate(tree, generated);
+            std::ostringstream rendered;
+            generator->render(*root, rendered);
+            REQUIRE(rendered.str() == generated.str());
+        }
+
+        std::ostringstream rendered;
+        anki.render(*root, rendered);
+        REQUIRE(rendered.str() ==
+                "What is <strong>bold</strong> ? \t<table style=\"border: 1px "
+                "solid black; border-collapse: collapse\"><tr><td "
+                "style=\"border: 1px solid black; text-align: left; padding: "
+                "1em\">a</td><td style=\"border: 1px solid black; padding: "
+                "1em\">b</td></tr></table><ul><li>one [$]x[/$]</li><li>two"
+                "</li></ul>\t\n");
+    }
+}
+
+TEST_CASE("parser ast rendered in parallel", "[parser]") {
+    std::string input;
+    for (int chapter = 0; chapter < 4; ++chapter) {
+        input += "CHA: chapter " + std::to_string(chapter) + "\n";
+        for (int section = 0; section < 3; ++section) {
+            input += "SEC: section " + std::to_string(section) + "\n";
+            // some sections are empty and aren't rendered
+            for (int question = 0; question < chapter * section * 20;
+                 ++question) {
+                input += "Q: question " + std::to_string(question) +
+                         "?\nA: - *answer*\n   - \\(x\\)\n";
+            }
+        }
+    }
+
+    qac::lexer lexer;
+    std::vector<qac::token> tokens = lexer.lex(input.data(), input.size());
+    qac::parser parser;
+    qac::token_vector_source source(tokens);
+    qac::ast_builder builder;
+    parser.parse(source, builder);
+    qac::ast_node::ptr root = builder.root();
+
+    qac::html_generator html;
+    qac::anki_generator anki;
+    for (qac::generator *generator :
+         std::vector<qac::generator *>{&html, &anki}) {
+        std::ostringstream serial;
+        generator->render(*root, serial);
+        REQUIRE(serial.str().find("question 119") != std::string::npos);
+
+        for (unsigned threads : {2u, 4u, 0u}) {
+            generator->set_threads(threads);
+            std::ostringstream parallel;
+            generator->render(*root, parallel);
+            REQUIRE(parallel.str() == serial.str());
+        }
+        generator->set_threads(1);
+    }
+}